@@ -0,0 +1,91 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <xmr/utility/profiler/compact_histogram.hpp>
+#include <xmr/utility/profiler/histogram.hpp>
+
+// Compares memory use and scan/merge time of histograms with 64-bit counters against compact ones.
+
+#define ZONES 1000
+#define EVENTS 20000
+#define ROUNDS 20
+
+template<typename T>
+static void run(const char* name, std::vector<T>& zones)
+{
+	size_t memory = 0;
+	for (auto& zone : zones) {
+		memory += zone.memory();
+	}
+
+	// Scan every zone for a percentile, which walks the counters front to back.
+	uint64_t checksum = 0;
+	auto     start    = std::chrono::high_resolution_clock::now();
+	for (int round = 0; round < ROUNDS; round++) {
+		for (auto& zone : zones) {
+			checksum += zone.percentile_events(0.99);
+		}
+	}
+	auto   end  = std::chrono::high_resolution_clock::now();
+	double scan = std::chrono::duration<double, std::milli>(end - start).count() / ROUNDS;
+
+	// Merge all zones into one.
+	start = std::chrono::high_resolution_clock::now();
+	for (int round = 0; round < ROUNDS; round++) {
+		T merged;
+		for (auto& zone : zones) {
+			merged.add(zone);
+		}
+		checksum += merged.total_events();
+	}
+	end          = std::chrono::high_resolution_clock::now();
+	double merge = std::chrono::duration<double, std::milli>(end - start).count() / ROUNDS;
+
+	printf("%-10s %10.2f KiB %10.3f ms %10.3f ms (%" PRIu64 ")\n", name, memory / 1024., scan, merge, checksum);
+}
+
+struct wide : public xmr::utility::profiler::histogram {
+	size_t memory() const
+	{
+		return sizeof(histogram) + size() * sizeof(uint64_t);
+	}
+};
+
+int main(int argc, const char** argv)
+{
+	std::vector<wide>                                      wides(ZONES);
+	std::vector<xmr::utility::profiler::compact_histogram> compacts(ZONES);
+
+	// Latencies around a per-zone median, with a long tail.
+	std::mt19937_64 random(0);
+	for (size_t zone = 0; zone < ZONES; zone++) {
+		std::lognormal_distribution<double> latency(std::log(1000. + (random() % 1000000)), 0.5);
+		for (size_t event = 0; event < EVENTS; event++) {
+			uint64_t value = static_cast<uint64_t>(latency(random));
+			wides[zone].record(value);
+			compacts[zone].record(value);
+		}
+	}
+
+	printf("%-10s %14s %13s %13s\n", "Counters", "Memory", "Scan", "Merge");
+	run("64-bit", wides);
+	run("compact", compacts);
+	return 0;
+}
@@ -0,0 +1,125 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_ACTIVE_HPP
+#define XMR_UTILITY_PROFILER_ACTIVE_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <vector>
+#include "xmr/utility/profiler/clock/hpc.hpp"
+#include "xmr/utility/profiler/registry.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			namespace active {
+				/** Maximum number of nested zones stored per thread.
+				 *
+				 * Deeper zones are still counted, but only the outermost ones are visible to snapshot().
+				 */
+				static const size_t max_depth = 64;
+
+				/** Zone that is currently open on a thread.
+				 */
+				struct entry {
+					uint32_t zone;  // Zone identifier from the registry.
+					uint64_t start; // Time in nanoseconds, see clock::hpc.
+				};
+
+				/** Copy of the active zones of a single thread.
+				 */
+				struct stack {
+					uint32_t           thread;  // Sequential number of the thread, starting at 1.
+					size_t             depth;   // Number of open zones, may be larger than entries.size().
+					std::vector<entry> entries; // Outermost zone first.
+				};
+
+				/** Time a thread has spent inside top-level zones.
+				 */
+				struct thread_usage {
+					uint32_t thread; // Sequential number of the thread, starting at 1.
+					uint64_t busy;   // Time in nanoseconds, including the top-level zone that is still open.
+				};
+
+				/** Mark a zone as open on the calling thread.
+				 *
+				 * Never blocks. The first call on a thread registers it, which takes a lock once.
+				 *
+				 * @param zone Zone identifier from the registry.
+				 * @param now Current time in nanoseconds, see clock::hpc.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void push(uint32_t zone, uint64_t now);
+
+				/** Mark the innermost zone of the calling thread as closed.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void pop();
+
+				/** Enable or disable accounting of the time spent inside top-level zones.
+				 *
+				 * While enabled, closing a top-level zone reads the clock once more to add its duration to the busy
+				 * time of the thread. Disabled by default.
+				 *
+				 * @param enabled true to account busy time, false to stop.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void account(bool enabled);
+
+				/** Get the busy time of all threads.
+				 *
+				 * Busy time only grows while accounting is enabled, so usage over an interval is the difference
+				 * between two calls. A thread that exits leaves its busy time to the next thread reusing its number.
+				 *
+				 * @param usage Receives one entry per running thread that has opened a zone.
+				 * @param now Current time in nanoseconds, see clock::hpc.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void usage(std::vector<thread_usage>& usage, uint64_t now);
+
+				/** Copy the active zones of all threads that have at least one zone open.
+				 *
+				 * Each copy is consistent on its own. Recording threads are never blocked; the copy is retried instead
+				 * if it raced with a push or pop.
+				 *
+				 * @param stacks Receives one stack per thread.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void snapshot(std::vector<stack>& stacks);
+
+				/** Scoped active zone
+				 *
+				 * Marks a zone as open on construction and closed on destruction.
+				 */
+				class scope {
+					public:
+					scope(uint32_t zone)
+					{
+						push(zone, clock::hpc::now());
+					}
+
+					~scope()
+					{
+						pop();
+					}
+
+					scope(const scope&) = delete;
+					scope& operator=(const scope&) = delete;
+				};
+			} // namespace active
+
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
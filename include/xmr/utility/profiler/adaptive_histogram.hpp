@@ -0,0 +1,142 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_ADAPTIVE_HISTOGRAM_HPP
+#define XMR_UTILITY_PROFILER_ADAPTIVE_HISTOGRAM_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <atomic>
+#include "xmr/utility/profiler/histogram.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Adaptive Histogram
+			 *
+			 * Same layout as histogram, but safe for concurrent recording and sized to what it actually holds. It
+			 * starts out with a small sorted array of (bucket, count) pairs stored inline, and promotes itself to a
+			 * dense array of all buckets once more distinct buckets are recorded than fit inline. A zone that is only
+			 * hit a handful of times therefore costs about a hundred bytes instead of a full dense array.
+			 *
+			 * While sparse, recording takes a small spin lock. Once dense, recording is a single atomic increment.
+			 * Promotion happens under the lock and publishes the dense array only after all sparse counts have been
+			 * copied into it, so no count is lost or counted twice.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT adaptive_histogram {
+				public:
+				/** Number of distinct buckets stored inline before promoting to a dense array.
+				 */
+				static const size_t sparse_capacity = 8;
+
+				private:
+				std::atomic<std::atomic<uint64_t>*> _dense;
+				std::atomic<bool>                   _lock; // Protects the sparse array, and promotion.
+				uint32_t                            _precision;
+				uint32_t                            _sparse_size;
+				uint32_t                            _sparse_buckets[sparse_capacity]; // Sorted ascending.
+				uint64_t                            _sparse_counts[sparse_capacity];
+
+				public:
+				~adaptive_histogram();
+
+				/** Create a new empty histogram.
+				 *
+				 * @param precision Number of bits of precision, from 1 to 20, see histogram.
+				 */
+				adaptive_histogram(uint32_t precision = 8);
+
+				adaptive_histogram(const adaptive_histogram&) = delete;
+				adaptive_histogram& operator=(const adaptive_histogram&) = delete;
+
+				/** Record a value.
+				 *
+				 * @param value The value to record.
+				 * @param count How often the value occurred.
+				 */
+				XMR_UTILITY_PROFILER_INLINE
+				void record(uint64_t value, uint64_t count = 1)
+				{
+					size_t                 bucket = histogram::index(value, _precision);
+					std::atomic<uint64_t>* dense  = _dense.load(std::memory_order_acquire);
+					if (dense) {
+						dense[bucket].fetch_add(count, std::memory_order_relaxed);
+					} else {
+						record_sparse(static_cast<uint32_t>(bucket), count);
+					}
+				}
+
+				/** Track a profiled event.
+				 *
+				 * @param time_end The end time recorded for the event.
+				 * @param time_start The start time recorded for the event.
+				 * @return Difference between time_end and time_start.
+				 */
+				uint64_t track(uint64_t time_end, uint64_t time_start);
+
+				/** Remove all counts, but keep the dense array if there is one.
+				 */
+				void clear();
+
+				/** Add all counts to a histogram.
+				 *
+				 * @param target Histogram to add the counts to, resampled if its precision differs.
+				 */
+				void snapshot(histogram& target);
+
+				/** Get the precision.
+				 *
+				 * @return Number of bits of precision.
+				 */
+				uint32_t precision() const
+				{
+					return _precision;
+				}
+
+				/** Check whether the histogram has been promoted to a dense array.
+				 *
+				 * @return true if dense, otherwise false.
+				 */
+				bool is_dense() const
+				{
+					return _dense.load(std::memory_order_relaxed) != nullptr;
+				}
+
+				/** Get the memory used by the histogram, including the object itself.
+				 *
+				 * @return Number of bytes.
+				 */
+				size_t memory() const;
+
+				public /*Statistics*/:
+
+				/** Get the total number of values.
+				 *
+				 * @return Total number of values.
+				 */
+				uint64_t total_events();
+
+				private:
+				void record_sparse(uint32_t bucket, uint64_t count);
+				void lock();
+				void unlock();
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
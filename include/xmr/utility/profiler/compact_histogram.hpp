@@ -0,0 +1,150 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_COMPACT_HISTOGRAM_HPP
+#define XMR_UTILITY_PROFILER_COMPACT_HISTOGRAM_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <vector>
+#include "xmr/utility/profiler/histogram.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Compact Histogram
+			 *
+			 * Same layout as histogram, but with counters only as wide as the largest count requires. Counters start
+			 * out 16 bits wide, and the whole array is widened to 32 and then 64 bits the first time a count would
+			 * not fit anymore. Most histograms never leave 16 or 32 bits, which makes them a quarter or half the size
+			 * of a histogram, and scanning or merging them touches that much less memory.
+			 *
+			 * Not safe for concurrent modification, same as histogram.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT compact_histogram {
+				uint32_t              _precision;
+				uint32_t              _width; // Bytes per counter, 2, 4 or 8.
+				std::vector<uint16_t> _counts16;
+				std::vector<uint32_t> _counts32;
+				std::vector<uint64_t> _counts64;
+				uint64_t              _total;
+
+				public:
+				~compact_histogram();
+
+				/** Create a new empty histogram with 16-bit counters.
+				 *
+				 * @param precision Number of bits of precision, from 1 to 20, see histogram.
+				 */
+				compact_histogram(uint32_t precision = 8);
+
+				/** Record a value.
+				 *
+				 * @param value The value to record.
+				 * @param count How often the value occurred.
+				 */
+				XMR_UTILITY_PROFILER_INLINE
+				void record(uint64_t value, uint64_t count = 1)
+				{
+					size_t bucket = histogram::index(value, _precision);
+					_total += count;
+					if (_width == 2) {
+						if ((count <= 0xFFFFu) && (_counts16[bucket] <= (0xFFFFu - count))) {
+							_counts16[bucket] = static_cast<uint16_t>(_counts16[bucket] + count);
+							return;
+						}
+					} else if (_width == 4) {
+						if ((count <= 0xFFFFFFFFu) && (_counts32[bucket] <= (0xFFFFFFFFu - count))) {
+							_counts32[bucket] = static_cast<uint32_t>(_counts32[bucket] + count);
+							return;
+						}
+					} else {
+						_counts64[bucket] += count;
+						return;
+					}
+					record_wide(bucket, count);
+				}
+
+				/** Add the counts of another compact histogram.
+				 *
+				 * Counters are widened first if the sums would not fit.
+				 *
+				 * @param other Histogram to add, resampled first if its precision differs.
+				 */
+				void add(const compact_histogram& other);
+
+				/** Add the counts of a histogram.
+				 *
+				 * @param other Histogram to add, resampled first if its precision differs.
+				 */
+				void add(const histogram& other);
+
+				/** Add all counts to a histogram.
+				 *
+				 * @param target Histogram to add the counts to, resampled if its precision differs.
+				 */
+				void snapshot(histogram& target) const;
+
+				/** Remove all counts, but keep the current counter width.
+				 */
+				void clear();
+
+				/** Get the current width of the counters.
+				 *
+				 * @return Bytes per counter, 2, 4 or 8.
+				 */
+				uint32_t width() const
+				{
+					return _width;
+				}
+
+				/** Get the memory used by the histogram, including the object itself.
+				 *
+				 * @return Number of bytes.
+				 */
+				size_t memory() const
+				{
+					return sizeof(compact_histogram) + histogram::size(_precision) * _width;
+				}
+
+				public /*Statistics*/:
+
+				/** Get the total number of values.
+				 *
+				 * @return Total number of values.
+				 */
+				uint64_t total_events() const
+				{
+					return _total;
+				}
+
+				/** Percentile (by events)
+				 *
+				 * @param percentile The percentile (as 0.0 - 1.0) to find a match for.
+				 * @return Highest value of the bucket that matches the percentile, or 0 if empty.
+				 */
+				uint64_t percentile_events(double percentile) const;
+
+				private:
+				void record_wide(size_t bucket, uint64_t count);
+				void widen(uint32_t width);
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
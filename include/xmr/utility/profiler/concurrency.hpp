@@ -0,0 +1,143 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_CONCURRENCY_HPP
+#define XMR_UTILITY_PROFILER_CONCURRENCY_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** In-Flight Concurrency Tracker
+			 *
+			 * Counts how many events are inside a zone at once. The gauge is split into shards selected by the calling
+			 * thread, so entering and leaving only touches a cache line shared with few other threads. Summing the
+			 * total reads every shard, so it is only sampled into the histogram of concurrency levels at every Nth
+			 * entry on each shard.
+			 *
+			 * Timestamps are supplied by the caller, in the same unit as given to profiler::track.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT concurrency {
+				struct shard {
+					std::atomic<int64_t>  inflight; // Events inside, negative if more left on this shard than entered.
+					std::atomic<uint64_t> time;     // Total time spent inside by events that have left.
+					std::atomic<uint32_t> entries;  // Entries on this shard, selects the ones that sample the gauge.
+					char                  padding[64 - sizeof(std::atomic<int64_t>) - sizeof(std::atomic<uint64_t>)
+												  - sizeof(std::atomic<uint32_t>)];
+				};
+
+				size_t                                   _shards_count;
+				std::unique_ptr<shard[]>                 _shards;
+				size_t                                   _levels;    // Histogram buckets, the last collects overflow.
+				std::unique_ptr<std::atomic<uint64_t>[]> _histogram; // Per-shard rows of _levels buckets.
+				uint32_t                                 _sample;
+				std::atomic<uint64_t>                    _max;
+				std::atomic<uint64_t>                    _origin;  // Timestamp of the first entry.
+				std::atomic<uint32_t>                    _started; // 0 before the first entry, 2 once set.
+
+				public:
+				/** Token returned by enter() that must be handed to leave().
+				 */
+				struct token {
+					size_t   shard;
+					uint64_t start;
+				};
+
+				~concurrency();
+
+				/** Create a new concurrency tracker.
+				 *
+				 * @param levels Number of concurrency levels to keep in the histogram, higher levels are clamped.
+				 * @param shards Number of shards for the gauge, 0 to derive it from the number of hardware threads.
+				 * @param sample Sample the gauge at every Nth entry on each shard, 1 to sample every entry.
+				 */
+				concurrency(size_t levels = 64, size_t shards = 0, uint32_t sample = 16);
+
+				concurrency(const concurrency&) = delete;
+				concurrency& operator=(const concurrency&) = delete;
+
+				/** Mark an event as entering the zone.
+				 *
+				 * @param now Current time.
+				 * @return Token to pass to leave().
+				 */
+				token enter(uint64_t now);
+
+				/** Mark an event as leaving the zone.
+				 *
+				 * @param entry Token returned by enter().
+				 * @param now Current time.
+				 */
+				void leave(const token& entry, uint64_t now);
+
+				/** Reset the histogram, maximum and average, but not events that are currently inside.
+				 *
+				 * Not exact while events enter or leave: the shards are reset one by one, and events that entered
+				 * before the call still add their full time inside to the average when they leave.
+				 */
+				void clear();
+
+				public /*Statistics*/:
+
+				/** Get the number of events currently inside the zone.
+				 *
+				 * @return Sum of all shards at the time of the call.
+				 */
+				uint64_t current();
+
+				/** Get the highest concurrency observed at a sampled entry.
+				 *
+				 * @return Maximum number of events inside the zone at once.
+				 */
+				uint64_t maximum();
+
+				/** Get the time-weighted average concurrency.
+				 *
+				 * This is the total time spent inside the zone by events that have left, divided by the time elapsed
+				 * since the first entry. It can be compared against arrival rate times average latency to check
+				 * Little's law.
+				 *
+				 * @param now Current time.
+				 * @return Average number of events inside the zone.
+				 */
+				double average(uint64_t now);
+
+				/** Get the merged histogram of concurrency levels sampled at entry.
+				 *
+				 * Each sampled entry counts for all entries since the previous sample on its shard.
+				 *
+				 * @param counts Receives the number of entries that saw index + 1 events inside, including itself.
+				 */
+				void histogram(std::vector<uint64_t>& counts);
+
+				/** Percentile (by entries)
+				 *
+				 * @param percentile The percentile (as 0.0 - 1.0) to find a match for.
+				 * @return The concurrency level that matches the percentile.
+				 */
+				uint64_t percentile(double percentile);
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
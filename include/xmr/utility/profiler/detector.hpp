@@ -0,0 +1,103 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_DETECTOR_HPP
+#define XMR_UTILITY_PROFILER_DETECTOR_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <functional>
+#include "xmr/utility/profiler/profiler.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Online Change-Point Detector
+			 *
+			 * Watches a profiler for shifts in its latency distribution using a two-sided Page-Hinkley test on the
+			 * logarithm of the average latency per interval. The detector only does work in update(), which is meant
+			 * to be called periodically from a reporting thread, so recording into the profiler costs nothing extra.
+			 *
+			 * After a change has been reported, the detector learns the new level from scratch.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT detector {
+				public:
+				/** Detected change of the latency level.
+				 */
+				struct event {
+					uint32_t zone;      // Zone identifier given to the constructor.
+					uint64_t time;      // Time given to update() when the change was detected.
+					double   magnitude; // Ratio of the latest interval average to the previous level, >1 is slower.
+				};
+
+				/** Function called for every detected change.
+				 */
+				typedef std::function<void(const event&)> callback_t;
+
+				private:
+				uint32_t   _zone;
+				profiler&  _profiler;
+				double     _delta;
+				double     _threshold;
+				uint64_t   _warmup;
+				callback_t _callback;
+
+				uint64_t _last_events;
+				uint64_t _last_time;
+				uint64_t _samples;
+				double   _mean;
+				double   _up;
+				double   _up_min;
+				double   _down;
+				double   _down_min;
+
+				public:
+				~detector();
+
+				/** Create a new detector.
+				 *
+				 * @param zone Zone identifier from the registry, reported in events.
+				 * @param source Profiler to watch, must outlive the detector.
+				 * @param callback Function called for every detected change.
+				 * @param delta Change of log-latency per interval that is tolerated as noise, 0.05 is about 5%.
+				 * @param threshold Accumulated log-latency deviation at which a change is reported.
+				 * @param warmup Number of intervals used to learn a level before changes are reported.
+				 */
+				detector(uint32_t zone, profiler& source, const callback_t& callback, double delta = 0.05,
+						 double threshold = 1.0, uint64_t warmup = 5);
+
+				detector(const detector&) = delete;
+				detector& operator=(const detector&) = delete;
+
+				/** Close the current interval and test it for a change.
+				 *
+				 * Intervals without events are skipped, and the baseline starts over if the profiler was cleared.
+				 *
+				 * @param now Current time, reported in events.
+				 * @return true if a change was detected, otherwise false.
+				 */
+				bool update(uint64_t now);
+
+				/** Forget the learned level, for example after clearing the profiler.
+				 */
+				void reset();
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
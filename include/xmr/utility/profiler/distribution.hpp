@@ -0,0 +1,79 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_DISTRIBUTION_HPP
+#define XMR_UTILITY_PROFILER_DISTRIBUTION_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <vector>
+#include "xmr/utility/profiler/histogram.hpp"
+#include "xmr/utility/profiler/profiler.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Shape of a distribution of times.
+			 *
+			 * Moments describe the whole distribution, while the quartiles and the median absolute deviation are
+			 * robust against a few extreme outliers. A bimodality coefficient above 5/9 together with more than one
+			 * entry in modes points at a zone that takes two or more distinct paths, for example cache hits and misses.
+			 */
+			struct distribution {
+				uint64_t            count;
+				uint64_t            minimum;
+				uint64_t            maximum;
+				double              mean;
+				double              variance;   // Population variance.
+				double              deviation;  // Population standard deviation.
+				double              skewness;   // Population skewness, 0 for a symmetric distribution.
+				double              kurtosis;   // Excess kurtosis, 0 for a normal distribution.
+				double              q1;         // 25th percentile.
+				double              median;     // 50th percentile.
+				double              q3;         // 75th percentile.
+				double              iqr;        // Interquartile range, q3 - q1.
+				double              mad;        // Median absolute deviation from the median.
+				double              bimodality; // Sample bimodality coefficient, from 0 to 1.
+				std::vector<double> modes;      // Centers of the peaks in density, highest peak first.
+			};
+
+			/** Summarize the shape of a histogram.
+			 *
+			 * Computed in a single walk over the buckets plus a walk outwards from the median, which is cheaper than
+			 * asking for the same percentiles one at a time. Every value is taken to be the middle of its bucket.
+			 *
+			 * @param source Histogram to summarize.
+			 * @return Shape of the distribution, all 0 if the histogram is empty.
+			 */
+			XMR_UTILITY_PROFILER_LIBRARY_EXPORT distribution summary(const histogram& source);
+
+			/** Summarize the shape of a profiler's timings.
+			 *
+			 * Moments and percentiles are computed from the exact timings. Modes are searched for in the density of a
+			 * log-linear layout, as exact timings are too sparse to show peaks.
+			 *
+			 * @param source Profiler to summarize.
+			 * @param precision Number of bits of precision of the layout used to find modes, see histogram.
+			 * @return Shape of the distribution, all 0 if nothing was tracked.
+			 */
+			XMR_UTILITY_PROFILER_LIBRARY_EXPORT distribution summary(xmr::utility::profiler::profiler& source,
+																	 uint32_t                          precision = 8);
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
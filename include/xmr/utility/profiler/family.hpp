@@ -0,0 +1,165 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_FAMILY_HPP
+#define XMR_UTILITY_PROFILER_FAMILY_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "xmr/utility/profiler/profiler.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Labeled Profiler Family
+			 *
+			 * Splits the timings of a zone by a fixed set of labels, for example status code and tenant. Each distinct
+			 * combination of label values gets its own profiler, created on first use.
+			 *
+			 * Looking up a combination hashes all of its values, so hot paths should look it up once and keep the
+			 * returned profiler, after which tracking costs exactly as much as with an unlabeled profiler.
+			 *
+			 * All families share one budget of combinations. Once it is used up, new combinations are tracked by a
+			 * per-family overflow profiler whose label values are all "(overflow)", and counted by overflowed().
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT family {
+				public:
+				/** A single combination of label values and its profiler.
+				 */
+				struct series {
+					std::vector<std::string>          values; // One per label, in order of labels().
+					xmr::utility::profiler::profiler* timings;
+					bool                              overflow; // true for the overflow profiler.
+				};
+
+				private:
+				struct entry {
+					std::vector<std::string>         values;
+					xmr::utility::profiler::profiler timings;
+				};
+
+				uint32_t                 _zone;
+				std::vector<std::string> _labels;
+				entry                    _overflow;
+				std::atomic<uint64_t>    _overflowed;
+
+				std::mutex                                              _lock; // Protects everything below.
+				std::unordered_map<std::string, std::unique_ptr<entry>> _entries;
+				std::vector<entry*>                                     _order; // In order of creation.
+
+				public:
+				~family();
+
+				/** Create a new family.
+				 *
+				 * @param zone Zone identifier from the registry, used as the metric name when exporting.
+				 * @param labels Names of the labels, for example {"status", "tenant"}.
+				 */
+				family(uint32_t zone, const std::vector<std::string>& labels);
+
+				family(const family&) = delete;
+				family& operator=(const family&) = delete;
+
+				/** Get the profiler for a combination of label values.
+				 *
+				 * Missing values are treated as empty, and values beyond the number of labels are ignored.
+				 *
+				 * @param values One value per label, in order of labels().
+				 * @return Profiler for the combination, valid for the lifetime of the family.
+				 */
+				xmr::utility::profiler::profiler& get(std::initializer_list<const char*> values);
+
+				/** Get the profiler for a combination of label values.
+				 *
+				 * @param values One value per label, in order of labels().
+				 * @return Profiler for the combination, valid for the lifetime of the family.
+				 */
+				xmr::utility::profiler::profiler& get(const std::vector<std::string>& values);
+
+				/** Get the zone of the family.
+				 *
+				 * @return Zone identifier from the registry.
+				 */
+				uint32_t zone() const
+				{
+					return _zone;
+				}
+
+				/** Get the names of the labels.
+				 *
+				 * @return Names of the labels, in the order values are given to get().
+				 */
+				const std::vector<std::string>& labels() const
+				{
+					return _labels;
+				}
+
+				/** Get the number of lookups that were folded into the overflow profiler.
+				 *
+				 * @return Number of folded lookups.
+				 */
+				uint64_t overflowed() const
+				{
+					return _overflowed.load(std::memory_order_relaxed);
+				}
+
+				/** Get all combinations created so far.
+				 *
+				 * @param entries Receives one entry per combination in order of creation, followed by the overflow
+				 *                profiler if anything was folded into it.
+				 */
+				void collect(std::vector<series>& entries);
+
+				/** Set the number of combinations shared by all families.
+				 *
+				 * Combinations that already exist are kept, even if they exceed the new budget.
+				 *
+				 * @param combinations Maximum number of combinations across all families.
+				 */
+				static void budget(size_t combinations);
+
+				/** Get the number of combinations used across all families.
+				 *
+				 * @return Number of combinations, not counting overflow profilers.
+				 */
+				static size_t used();
+
+				/** Write all families in the Prometheus text exposition format.
+				 *
+				 * Each family becomes a summary named after its zone, with the label values of every combination and
+				 * quantiles 0.5, 0.9 and 0.99. Families that map to the same metric name are written as one metric.
+				 * Folded lookups are written as a counter with the suffix "_overflowed_total". Labels named "quantile"
+				 * or starting with "__" are reserved, and get the prefix "exported_".
+				 *
+				 * @param file File to write to.
+				 * @return true if everything was written, otherwise false.
+				 */
+				static bool write_prometheus(std::FILE* file);
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
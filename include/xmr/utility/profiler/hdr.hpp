@@ -0,0 +1,118 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_HDR_HPP
+#define XMR_UTILITY_PROFILER_HDR_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "xmr/utility/profiler/histogram.hpp"
+
+/* HdrHistogram interoperability
+ *
+ * Reads and writes the V2 compressed encoding of HdrHistogram: a big-endian header, the counts as ZigZag LEB128
+ * with runs of empty buckets collapsed, and all of it deflated into a zlib stream. The text form is the same
+ * encoding in base64, as found in HdrHistogram interval logs.
+ *
+ * The histogram layout matches HdrHistogram for precisions 1, 5, 8, 11, 15 and 18, which correspond to 0 to 5
+ * significant digits. Other precisions are resampled to the next matching one when encoding. To serialize a
+ * profiler, add it to a histogram first.
+ */
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			namespace hdr {
+				/** Encoder with reusable buffers.
+				 *
+				 * Keeps all intermediate buffers between calls, so once it has encoded the largest histogram it will
+				 * see, it does not allocate anymore.
+				 */
+				class XMR_UTILITY_PROFILER_LIBRARY_EXPORT encoder {
+					std::vector<uint8_t>       _payload;  // Uncompressed encoding.
+					std::vector<uint8_t>       _output;   // Compressed encoding.
+					std::vector<int32_t>       _matches;  // Most recent position of each 3-byte hash.
+					std::string                _text;     // Base64 of the compressed encoding.
+					std::unique_ptr<histogram> _resample; // Only used if the precision does not match.
+
+					public:
+					~encoder();
+
+					/** Create a new encoder.
+					 */
+					encoder();
+
+					encoder(const encoder&) = delete;
+					encoder& operator=(const encoder&) = delete;
+
+					/** Encode a histogram into the V2 compressed encoding.
+					 *
+					 * @param source Histogram to encode.
+					 * @return Encoded bytes, valid until the next call.
+					 */
+					const std::vector<uint8_t>& encode(const histogram& source);
+
+					/** Encode a histogram into the base64 text form of the V2 compressed encoding.
+					 *
+					 * @param source Histogram to encode.
+					 * @return Encoded text, valid until the next call.
+					 */
+					const std::string& encode_base64(const histogram& source);
+				};
+
+				/** Decode the V2 compressed or uncompressed encoding and add its counts to a histogram.
+				 *
+				 * @param data Encoded bytes.
+				 * @param size Number of encoded bytes.
+				 * @param target Histogram to add the counts to, resampled if its precision differs.
+				 * @return true if the data was decoded, otherwise false and the histogram is unchanged.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT bool decode(const uint8_t* data, size_t size, histogram& target);
+
+				/** Decode the base64 text form and add its counts to a histogram.
+				 *
+				 * @param text Encoded text, surrounding whitespace is ignored.
+				 * @param length Length of the text.
+				 * @param target Histogram to add the counts to, resampled if its precision differs.
+				 * @return true if the text was decoded, otherwise false and the histogram is unchanged.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT bool decode_base64(const char* text, size_t length,
+																	   histogram& target);
+
+				/** Add all intervals of an HdrHistogram log to a histogram.
+				 *
+				 * Comment and header lines are skipped, as are interval tags.
+				 *
+				 * @param file Log to read.
+				 * @param target Histogram to add the counts to.
+				 * @param skipped Receives the number of lines that looked like intervals but could not be decoded, if
+				 *                not null.
+				 * @return Number of intervals that were added.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT size_t read_log(std::FILE* file, histogram& target,
+																	size_t* skipped = nullptr);
+			} // namespace hdr
+
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
@@ -0,0 +1,173 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_HEAVY_HITTERS_HPP
+#define XMR_UTILITY_PROFILER_HEAVY_HITTERS_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "xmr/utility/profiler/profiler.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Heavy Hitter Tracker
+			 *
+			 * Finds the keys with the most events and the most total time out of a key space too large to keep a
+			 * profiler per key, such as user ids or hashed URLs. Both rankings are Space-Saving summaries of a fixed
+			 * number of keys: a key that is not monitored replaces the one with the lowest value and inherits that
+			 * value as its error. Every key whose true value exceeds 1/capacity of the total is guaranteed to be
+			 * monitored.
+			 *
+			 * Samples are first summed exactly in small tables selected by the calling thread, which are merged into
+			 * the summaries whenever they fill up and before every query.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT heavy_hitters {
+				public:
+				/** A monitored key.
+				 *
+				 * The true value of the key lies within [value - error, value].
+				 */
+				struct entry {
+					uint64_t key;
+					uint64_t value; // Estimated number of events or total time.
+					uint64_t error; // Maximum overestimation of value.
+				};
+
+				private:
+				class summary {
+					std::vector<entry>                   _heap; // Min-heap by value.
+					std::unordered_map<uint64_t, size_t> _index;
+					size_t                               _capacity;
+
+					public:
+					summary(size_t capacity);
+
+					void add(uint64_t key, uint64_t weight);
+					void get(std::vector<entry>& entries, size_t count);
+					void clear();
+
+					private:
+					void sift(size_t position);
+				};
+
+				struct slot {
+					uint64_t key;
+					uint64_t count; // 0 if the slot is empty.
+					uint64_t time;
+				};
+
+				struct shard {
+					std::mutex              lock;
+					std::unique_ptr<slot[]> slots;
+					size_t                  used;
+				};
+
+				xmr::utility::profiler::profiler* _timings;
+				size_t                            _slots; // Slots per shard, a power of two.
+				size_t                            _shards_count;
+				std::unique_ptr<shard[]>          _shards;
+
+				std::mutex _lock; // Protects everything below.
+				summary    _by_count;
+				summary    _by_time;
+				uint64_t   _total_count;
+				uint64_t   _total_time;
+
+				public:
+				~heavy_hitters();
+
+				/** Create a new heavy hitter tracker.
+				 *
+				 * @param capacity Number of keys monitored by each summary.
+				 * @param timings Profiler to also track every event into, or nullptr.
+				 * @param slots Number of keys each shard sums before merging, rounded up to a power of two.
+				 * @param shards Number of shards, 0 to derive it from the number of hardware threads.
+				 */
+				heavy_hitters(size_t capacity = 64, xmr::utility::profiler::profiler* timings = nullptr,
+							  size_t slots = 256, size_t shards = 0);
+
+				heavy_hitters(const heavy_hitters&) = delete;
+				heavy_hitters& operator=(const heavy_hitters&) = delete;
+
+				/** Track a profiled event of a key.
+				 *
+				 * @param key Key of the event, for example a hashed URL.
+				 * @param time_end The end time recorded for the event.
+				 * @param time_start The start time recorded for the event.
+				 * @return Difference between time_end and time_start.
+				 */
+				uint64_t track(uint64_t key, uint64_t time_end, uint64_t time_start);
+
+				/** Record an event of a key with a known duration.
+				 *
+				 * @param key Key of the event.
+				 * @param duration Duration of the event.
+				 */
+				void record(uint64_t key, uint64_t duration);
+
+				/** Merge all shards into the summaries.
+				 *
+				 * Happens automatically before every query, calling it periodically only bounds how stale the
+				 * summaries are in between.
+				 */
+				void merge();
+
+				/** Clear all shards and summaries, but not the attached profiler.
+				 */
+				void clear();
+
+				public /*Statistics*/:
+
+				/** Get the keys with the most events.
+				 *
+				 * @param entries Receives up to count keys, highest value first.
+				 * @param count Maximum number of keys to return, 0 for all monitored keys.
+				 */
+				void top_by_count(std::vector<entry>& entries, size_t count = 0);
+
+				/** Get the keys with the most total time.
+				 *
+				 * @param entries Receives up to count keys, highest value first.
+				 * @param count Maximum number of keys to return, 0 for all monitored keys.
+				 */
+				void top_by_time(std::vector<entry>& entries, size_t count = 0);
+
+				/** Get the total number of events of all keys.
+				 *
+				 * @return Total number of events.
+				 */
+				uint64_t total_events();
+
+				/** Get the total time of all keys.
+				 *
+				 * @return Total time spent in events.
+				 */
+				uint64_t total_time();
+
+				private:
+				void flush(shard& local); // Must be called with the lock of the shard held.
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
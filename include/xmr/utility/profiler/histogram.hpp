@@ -0,0 +1,255 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_HISTOGRAM_HPP
+#define XMR_UTILITY_PROFILER_HISTOGRAM_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <vector>
+#include "xmr/utility/profiler/profiler.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Log-Linear Histogram
+			 *
+			 * Counts values in buckets whose width grows with the value, so that every value is stored with a relative
+			 * error of at most 2^(1 - precision). Values below 2^precision are stored exactly. Above that, every power
+			 * of two is split into 2^(precision - 1) buckets of equal width. This is the same layout HdrHistogram uses
+			 * with a lowest discernible value of 1, covering the whole 64-bit range.
+			 *
+			 * Counts are kept in a flat array indexed by bucket, so adding, subtracting and scaling whole histograms
+			 * are simple loops the compiler can vectorize. Histograms with a different precision, as well as the
+			 * exact timings of a profiler, are resampled into the layout first.
+			 *
+			 * Not safe for concurrent modification, it is meant for snapshots and the arithmetic between them.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT histogram {
+				uint32_t              _precision;
+				std::vector<uint64_t> _counts;
+				uint64_t              _total;
+
+				public:
+				~histogram();
+
+				/** Create a new empty histogram.
+				 *
+				 * @param precision Number of bits of precision, from 1 to 20. Each additional bit halves the relative
+				 *                  error and doubles the memory used.
+				 */
+				histogram(uint32_t precision = 8);
+
+				/** Record a value.
+				 *
+				 * @param value The value to record.
+				 * @param count How often the value occurred.
+				 */
+				XMR_UTILITY_PROFILER_INLINE
+				void record(uint64_t value, uint64_t count = 1)
+				{
+					_counts[index(value)] += count;
+					_total += count;
+				}
+
+				/** Add the counts of another histogram.
+				 *
+				 * @param other Histogram to add, resampled first if its precision differs.
+				 */
+				void add(const histogram& other);
+
+				/** Add the timings of a profiler.
+				 *
+				 * @param other Profiler to add.
+				 */
+				void add(xmr::utility::profiler::profiler& other);
+
+				/** Subtract the counts of another histogram, for example an older snapshot of the same data.
+				 *
+				 * Buckets that would become negative are set to 0 instead.
+				 *
+				 * @param other Histogram to subtract, resampled first if its precision differs.
+				 */
+				void subtract(const histogram& other);
+
+				/** Multiply all counts by a factor, rounding to the nearest integer.
+				 *
+				 * @param factor Factor to multiply by, for example to extrapolate from a sampled rate.
+				 */
+				void scale(double factor);
+
+				/** Add the counts of this histogram to another with a different layout.
+				 *
+				 * Counts are assumed to be spread evenly within each bucket and are split between the target buckets
+				 * it overlaps. The total number of values is preserved exactly.
+				 *
+				 * @param target Histogram to add the counts to.
+				 */
+				void resample(histogram& target) const;
+
+				/** Remove all counts.
+				 */
+				void clear();
+
+				/** Get the bucket a value is counted in.
+				 *
+				 * @param value The value to look up.
+				 * @return Index of the bucket.
+				 */
+				XMR_UTILITY_PROFILER_INLINE
+				size_t index(uint64_t value) const
+				{
+					return index(value, _precision);
+				}
+
+				/** Get the bucket a value is counted in, for any precision.
+				 *
+				 * @param value The value to look up.
+				 * @param precision Number of bits of precision, from 1 to 20.
+				 * @return Index of the bucket.
+				 */
+				XMR_UTILITY_PROFILER_INLINE
+				static size_t index(uint64_t value, uint32_t precision)
+				{
+					// Values that fit into precision bits are their own bucket. Above, the bucket is selected by the
+					// position of the highest bit and the precision - 1 bits below it.
+					uint64_t shifted = value >> precision;
+					if (shifted == 0) {
+						return static_cast<size_t>(value);
+					}
+					uint32_t exponent = 63 - count_leading_zeros(shifted); // Power of two above the linear range.
+					return static_cast<size_t>((uint64_t(exponent + 1) << (precision - 1)) + (value >> (exponent + 1)));
+				}
+
+				/** Get the number of buckets for a precision.
+				 *
+				 * @param precision Number of bits of precision, from 1 to 20.
+				 * @return Number of buckets.
+				 */
+				static size_t size(uint32_t precision)
+				{
+					// One linear range of 2^precision buckets, then half as many for every remaining power of two.
+					return static_cast<size_t>(66 - precision) << (precision - 1);
+				}
+
+				/** Get the lowest value counted in a bucket.
+				 *
+				 * @param index Index of the bucket.
+				 * @return Lowest value of the bucket.
+				 */
+				uint64_t lowest(size_t index) const
+				{
+					return lowest(index, _precision);
+				}
+
+				/** Get the lowest value counted in a bucket, for any precision.
+				 *
+				 * @param index Index of the bucket.
+				 * @param precision Number of bits of precision, from 1 to 20.
+				 * @return Lowest value of the bucket.
+				 */
+				static uint64_t lowest(size_t index, uint32_t precision);
+
+				/** Get the highest value counted in a bucket.
+				 *
+				 * @param index Index of the bucket.
+				 * @return Highest value of the bucket.
+				 */
+				uint64_t highest(size_t index) const
+				{
+					return highest(index, _precision);
+				}
+
+				/** Get the highest value counted in a bucket, for any precision.
+				 *
+				 * @param index Index of the bucket.
+				 * @param precision Number of bits of precision, from 1 to 20.
+				 * @return Highest value of the bucket.
+				 */
+				static uint64_t highest(size_t index, uint32_t precision);
+
+				/** Get the precision the histogram was created with.
+				 *
+				 * @return Number of bits of precision.
+				 */
+				uint32_t precision() const
+				{
+					return _precision;
+				}
+
+				/** Get the number of buckets.
+				 *
+				 * @return Number of buckets.
+				 */
+				size_t size() const
+				{
+					return _counts.size();
+				}
+
+				/** Get the counts of all buckets.
+				 *
+				 * @return Pointer to size() counts.
+				 */
+				const uint64_t* counts() const
+				{
+					return _counts.data();
+				}
+
+				public /*Statistics*/:
+
+				/** Get the total number of values.
+				 *
+				 * @return Total number of values.
+				 */
+				uint64_t total_events() const
+				{
+					return _total;
+				}
+
+				/** Get the approximate sum of all values.
+				 *
+				 * @return Sum of all values, using the middle of each bucket.
+				 */
+				double total_time() const;
+
+				/** Percentile (by events)
+				 *
+				 * @param percentile The percentile (as 0.0 - 1.0) to find a match for.
+				 * @return Highest value of the bucket that matches the percentile, or 0 if empty.
+				 */
+				uint64_t percentile_events(double percentile) const;
+
+				private:
+				XMR_UTILITY_PROFILER_INLINE
+				static uint32_t count_leading_zeros(uint64_t value)
+				{
+#if defined(__GNUC__) || defined(__clang__)
+					return static_cast<uint32_t>(__builtin_clzll(value));
+#else
+					uint32_t count = 0;
+					for (uint64_t bit = uint64_t(1) << 63; (bit != 0) && ((value & bit) == 0); bit >>= 1) {
+						count++;
+					}
+					return count;
+#endif
+				}
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
@@ -0,0 +1,109 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_INSTRUMENT_HPP
+#define XMR_UTILITY_PROFILER_INSTRUMENT_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/* Automatic function profiling
+ *
+ * Link against xmr_utility_profiler_instrument and compile the code to profile with -finstrument-functions. Every
+ * instrumented function is then timed on entry and exit into a histogram keyed by its address. Code that is not
+ * compiled with the flag pays nothing.
+ */
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			namespace instrument {
+				/** Number of logarithmic buckets per function, bucket N holds durations in [2^N, 2^(N+1)) ns.
+				 */
+				static const size_t buckets = 40;
+
+				/** Merged timings of a single function.
+				 */
+				struct function {
+					void*       address;
+					std::string name; // Demangled name if it could be resolved, otherwise empty.
+					uint64_t    calls;
+					uint64_t    total; // Time in nanoseconds.
+					uint64_t    histogram[buckets];
+				};
+
+				/** Set the number of functions each thread can track.
+				 *
+				 * Only affects threads that have not called an instrumented function yet. Functions beyond the capacity
+				 * are counted by dropped() instead.
+				 *
+				 * @param functions Number of distinct functions per thread.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void capacity(size_t functions);
+
+				/** Time only every Nth call on each thread.
+				 *
+				 * @param every Sampling interval, 1 to time every call.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void sample(uint32_t every);
+
+				/** Exclude functions whose name starts with the given prefix.
+				 *
+				 * Both the mangled and the demangled name are checked, once per function and thread when it is first
+				 * timed, and excluded functions are not timed after that. Calls recorded before are dropped from
+				 * reports as well. For exclusion at compile time, use -finstrument-functions-exclude-file-list or
+				 * -finstrument-functions-exclude-function-list instead.
+				 *
+				 * @param prefix Name prefix, for example "std::".
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void exclude(const char* prefix);
+
+				/** Pause or resume timing of instrumented functions on all threads.
+				 *
+				 * @param enabled true to time functions, false to ignore them.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void enable(bool enabled);
+
+				/** Get the number of calls that were not timed due to a full table or stack.
+				 *
+				 * @return Number of dropped calls across all threads.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT uint64_t dropped();
+
+				/** Merge the timings of all threads and resolve function names.
+				 *
+				 * @param functions Receives one entry per function, sorted by total time, highest first.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void collect(std::vector<function>& functions);
+
+				/** Write a table of all timed functions.
+				 *
+				 * @param file File to write to.
+				 * @param limit Maximum number of functions to write, 0 for all.
+				 * @return true if everything was written, otherwise false.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT bool write_report(std::FILE* file, size_t limit = 0);
+			} // namespace instrument
+
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
@@ -0,0 +1,172 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_JSON_EXPORTER_HPP
+#define XMR_UTILITY_PROFILER_JSON_EXPORTER_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "xmr/utility/profiler/histogram.hpp"
+#include "xmr/utility/profiler/profiler.hpp"
+#include "xmr/utility/profiler/reporter.hpp"
+#include "xmr/utility/profiler/resources.hpp"
+#include "xmr/utility/profiler/slo.hpp"
+#include "xmr/utility/profiler/throughput.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** JSON Snapshot Exporter
+			 *
+			 * Writes a snapshot of every profiler and histogram added to it, plus the state of all latency objectives,
+			 * as a single JSON document:
+			 *
+			 *   {"zones":[{"zone":"name","id":0,"count":..,"sum":..,"min":..,"max":..,"mean":..,
+			 *              "quantiles":{"0.5":..},"buckets":[[value,count],..]}],
+			 *    "objectives":[{"zone":"name","threshold":..,"objective":..,"good":..,"bad":..,"burn_rates":[..]}],
+			 *    "throughput":[{"zone":"name","id":0,"count":..,"time":..,"units":..,"average":..,
+			 *                   "quantiles":{"0.5":..}}],
+			 *    "resources":{"time":[..],"resident":[..],..}}
+			 *
+			 * Throughput is in units per second, and its quantiles are the throughput that the given share of events
+			 * reached or exceeded, see throughput::percentile_throughput.
+			 *
+			 * Resource samples are written as one array per field of resources::sample, oldest first, and are only
+			 * present once resources::start() has taken a sample.
+			 *
+			 * Output is streamed through a fixed buffer, and numbers are formatted by hand instead of through
+			 * printf or iostreams. All scratch space is kept between calls, so repeated exports do not allocate once
+			 * the largest profiler has been seen.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT json_exporter {
+				struct source {
+					uint32_t                          zone;
+					xmr::utility::profiler::profiler* timings; // Either this or buckets is set.
+					histogram*                        buckets;
+				};
+
+				std::mutex                                    _lock; // Protects everything below.
+				std::vector<source>                           _sources;
+				std::vector<std::pair<uint32_t, throughput*>> _rates;
+				std::vector<double>                           _quantiles; // Sorted ascending.
+				bool                                          _buckets;
+				std::vector<std::pair<uint64_t, uint64_t>>    _scratch;
+				std::vector<uint64_t>                         _values;
+				std::vector<slo::status>                      _objectives;
+				std::vector<resources::sample>                _resources;
+				std::unique_ptr<histogram>                    _costs; // Snapshot of one throughput profiler.
+				std::vector<char>                             _buffer;
+
+				public:
+				~json_exporter();
+
+				/** Create a new exporter.
+				 *
+				 * @param quantiles Quantiles (as 0.0 - 1.0) to write for every zone.
+				 * @param buckets true to also write every non-empty bucket, as pairs of value and count.
+				 */
+				json_exporter(const std::vector<double>& quantiles = {0.5, 0.9, 0.99, 0.999}, bool buckets = false);
+
+				json_exporter(const json_exporter&) = delete;
+				json_exporter& operator=(const json_exporter&) = delete;
+
+				/** Add a profiler to export.
+				 *
+				 * @param zone Zone identifier from the registry, used as the name of the entry.
+				 * @param timings Profiler to export, must outlive the exporter or be removed first.
+				 */
+				void add(uint32_t zone, xmr::utility::profiler::profiler& timings);
+
+				/** Add a histogram to export.
+				 *
+				 * Histograms are not safe for concurrent modification, so it must not change while exporting.
+				 *
+				 * @param zone Zone identifier from the registry, used as the name of the entry.
+				 * @param buckets Histogram to export, must outlive the exporter or be removed first.
+				 */
+				void add(uint32_t zone, histogram& buckets);
+
+				/** Remove a profiler.
+				 *
+				 * @param timings Profiler previously added.
+				 */
+				void remove(xmr::utility::profiler::profiler& timings);
+
+				/** Remove a histogram.
+				 *
+				 * @param buckets Histogram previously added.
+				 */
+				void remove(histogram& buckets);
+
+				/** Add a throughput profiler to export.
+				 *
+				 * @param zone Zone identifier from the registry, used as the name of the entry.
+				 * @param rates Throughput profiler to export, must outlive the exporter or be removed first.
+				 */
+				void add(uint32_t zone, throughput& rates);
+
+				/** Remove a throughput profiler.
+				 *
+				 * @param rates Throughput profiler previously added.
+				 */
+				void remove(throughput& rates);
+
+				/** Write a snapshot to a file descriptor.
+				 *
+				 * @param fd File descriptor to write to, for example a file, pipe or socket.
+				 * @return true if everything was written, otherwise false.
+				 */
+				bool write(int fd);
+
+				/** Write a snapshot into a buffer.
+				 *
+				 * @param output Buffer to replace the contents of, its capacity is reused.
+				 */
+				void write(std::string& output);
+
+				/** Write a snapshot of the zones merged by a reporter to a file descriptor.
+				 *
+				 * The sources added to the exporter are ignored, and each zone is written as soon as the reporter
+				 * hands it over, using the quantiles of the reporter. Buckets are not written.
+				 *
+				 * @param fd File descriptor to write to, for example a file, pipe or socket.
+				 * @param source Reporter to run.
+				 * @return true if everything was written, otherwise false.
+				 */
+				bool write(int fd, reporter& source);
+
+				/** Write a snapshot of the zones merged by a reporter into a buffer.
+				 *
+				 * @param output Buffer to replace the contents of, its capacity is reused.
+				 * @param source Reporter to run.
+				 */
+				void write(std::string& output, reporter& source);
+
+				private:
+				template<typename Sink>
+				bool write(Sink& sink, reporter* source);
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
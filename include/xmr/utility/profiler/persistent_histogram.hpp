@@ -0,0 +1,143 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_PERSISTENT_HISTOGRAM_HPP
+#define XMR_UTILITY_PROFILER_PERSISTENT_HISTOGRAM_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <atomic>
+#include <string>
+#include "xmr/utility/profiler/histogram.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Persistent Histogram
+			 *
+			 * Same layout as histogram, but the counters live in a memory-mapped file and survive restarts of the
+			 * process. Recording is an atomic increment directly in the mapping, there is no serialization step. The
+			 * operating system writes changed pages back on its own; a background thread shared by all persistent
+			 * histograms can additionally flush them periodically, which bounds how much is lost if the machine itself
+			 * goes down.
+			 *
+			 * The file starts with a header holding the layout and a checksum. If the header is damaged, or was
+			 * written with a different precision, the file is reset instead of continued. Files use the byte order of
+			 * the machine and are not meant to be moved between architectures.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT persistent_histogram {
+				struct header;
+
+				std::string            _path;
+				uint32_t               _precision;
+				bool                   _restored;
+				void*                  _mapping;
+				size_t                 _size;
+				std::atomic<uint64_t>* _counts;
+				uint64_t               _sync_interval; // 0 if not registered with the shared sync thread.
+#ifdef _WIN32
+				void* _file;
+				void* _section;
+#else
+				int _file;
+#endif
+
+				public:
+				~persistent_histogram();
+
+				/** Open or create a persistent histogram.
+				 *
+				 * @param path File to keep the counters in, created if it does not exist.
+				 * @param precision Number of bits of precision, from 1 to 20, see histogram.
+				 * @param sync_interval Interval in nanoseconds at which to flush the mapping, or 0 to leave it to
+				 *                      the operating system.
+				 */
+				persistent_histogram(const char* path, uint32_t precision = 8, uint64_t sync_interval = 0);
+
+				persistent_histogram(const persistent_histogram&) = delete;
+				persistent_histogram& operator=(const persistent_histogram&) = delete;
+
+				/** Record a value.
+				 *
+				 * Does nothing if the file could not be opened.
+				 *
+				 * @param value The value to record.
+				 * @param count How often the value occurred.
+				 */
+				XMR_UTILITY_PROFILER_INLINE
+				void record(uint64_t value, uint64_t count = 1)
+				{
+					if (_counts) {
+						_counts[histogram::index(value, _precision)].fetch_add(count, std::memory_order_relaxed);
+					}
+				}
+
+				/** Track a profiled event.
+				 *
+				 * @param time_end The end time recorded for the event.
+				 * @param time_start The start time recorded for the event.
+				 * @return Difference between time_end and time_start.
+				 */
+				uint64_t track(uint64_t time_end, uint64_t time_start);
+
+				/** Remove all counts, in the file as well.
+				 */
+				void clear();
+
+				/** Add all counts to a histogram.
+				 *
+				 * @param target Histogram to add the counts to, resampled if its precision differs.
+				 */
+				void snapshot(histogram& target);
+
+				/** Flush all changed counters to the file and wait for it to complete.
+				 *
+				 * @return true if flushed, otherwise false.
+				 */
+				bool sync();
+
+				/** Check whether the file was opened and mapped.
+				 *
+				 * @return true if recording goes to the file, otherwise false.
+				 */
+				bool is_open() const
+				{
+					return _counts != nullptr;
+				}
+
+				/** Check whether existing counts were continued from the file.
+				 *
+				 * @return true if the file held a valid histogram when opened, false if it was created or reset.
+				 */
+				bool is_restored() const
+				{
+					return _restored;
+				}
+
+				public /*Statistics*/:
+
+				/** Get the total number of values.
+				 *
+				 * @return Total number of values, including those from before a restart.
+				 */
+				uint64_t total_events();
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
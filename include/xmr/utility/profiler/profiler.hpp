@@ -18,12 +18,28 @@
 #pragma once
 #include "xmr/utility/profiler/config.hpp"
 
+#include <limits>
 #include <map>
 #include <mutex>
 
 namespace xmr {
 	namespace utility {
 		namespace profiler {
+			/** Calculate the time between two timestamps, even if the clock wrapped over 0 in between.
+			 *
+			 * @param time_end The end time recorded for the event.
+			 * @param time_start The start time recorded for the event.
+			 * @return Difference between time_end and time_start.
+			 */
+			inline uint64_t elapsed(uint64_t time_end, uint64_t time_start)
+			{
+				if (time_end >= time_start) {
+					return time_end - time_start;
+				}
+				// Time has wrapped over 0, so count from the start up to max, then across 0 and on to the end.
+				return (std::numeric_limits<uint64_t>::max() - time_start) + time_end + 1;
+			}
+
 			/** Single-Type Event Profiler
 		     */
 			class profiler {
@@ -49,14 +65,7 @@ namespace xmr {
 				uint64_t track(uint64_t time_end, uint64_t time_start)
 				{
 					// Calculate time difference.
-					uint64_t difference;
-					if (time_end >= time_start) {
-						// Time has not wrapped over 0, we can simply calculate the difference between a and b.
-						difference = time_end - time_start;
-					} else { // Time has wrapped over 0.
-						// Time has wrapped over 0, need to subtract b from max.int then add a.
-						difference = (std::numeric_limits<uint64_t>::max() - time_end) + time_start;
-					}
+					uint64_t difference = elapsed(time_end, time_start);
 
 					// Try and insert the new time into the map.
 					std::unique_lock<std::mutex> l(_lock);
@@ -83,6 +92,30 @@ namespace xmr {
 					_timings.clear();
 				}
 
+				/** Copy the recorded timings.
+				 *
+				 * @param timings Receives the number of events per time difference.
+				 */
+				void timings(std::map<uint64_t, uint64_t>& timings)
+				{
+					std::unique_lock<std::mutex> l(_lock);
+					timings = _timings;
+				}
+
+				/** Visit the recorded timings in ascending order, without copying them.
+				 *
+				 * @param callback Called with each time difference and its number of events, while the profiler is
+				 *                 locked. Must not call back into the profiler.
+				 */
+				template<typename F>
+				void visit(F callback)
+				{
+					std::unique_lock<std::mutex> l(_lock);
+					for (auto& kv : _timings) {
+						callback(kv.first, kv.second);
+					}
+				}
+
 				public /*Statistics*/:
 
 				/** Get the total number of profiled events.
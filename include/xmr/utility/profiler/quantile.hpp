@@ -0,0 +1,115 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_QUANTILE_HPP
+#define XMR_UTILITY_PROFILER_QUANTILE_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include "xmr/utility/profiler/histogram.hpp"
+#include "xmr/utility/profiler/profiler.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Definition of a sample quantile, numbered as by Hyndman and Fan.
+			 *
+			 * The first three pick one of the values, the others interpolate between the two values around a position
+			 * that depends on the definition. All agree once there are many values, but differ noticeably for tail
+			 * quantiles of few values.
+			 */
+			enum class quantile_definition : uint32_t {
+				inverted_cdf              = 1, // Nearest rank, smallest value with at least p of values at or below.
+				averaged_inverted_cdf     = 2, // Like inverted_cdf, but averages the two values at an exact rank.
+				closest_observation       = 3, // Value at the nearest rank, even ranks on ties.
+				interpolated_inverted_cdf = 4, // Linear interpolation of the empirical distribution function.
+				hazen                     = 5, // Piecewise linear with the values at the middle of their steps.
+				weibull                   = 6, // Expected rank of the quantile, unbiased for uniform distributions.
+				linear                    = 7, // Linear between the values, the default of R and NumPy.
+				median_unbiased           = 8, // Approximately median-unbiased whatever the distribution.
+				normal_unbiased           = 9, // Approximately unbiased for normal distributions.
+			};
+
+			/** Quantile with a confidence interval.
+			 */
+			struct quantile_estimate {
+				double value;
+				double lower;   // Lower bound of the confidence interval.
+				double upper;   // Upper bound of the confidence interval.
+				bool   bounded; // false if there are too few values for the interval to reach the requested confidence.
+			};
+
+			/** Estimate a quantile of a profiler's timings.
+			 *
+			 * The position of the quantile is computed exactly in integers, with p rounded to nine decimals, so that
+			 * for example p99 of 100 values is always the 99th value instead of depending on rounding.
+			 *
+			 * @param source Profiler to estimate the quantile of.
+			 * @param p Quantile, from 0.0 to 1.0.
+			 * @param definition Definition of the quantile.
+			 * @return Estimated quantile, 0 if nothing was tracked.
+			 */
+			XMR_UTILITY_PROFILER_LIBRARY_EXPORT double
+				quantile(xmr::utility::profiler::profiler& source, double p,
+						 quantile_definition definition = quantile_definition::linear);
+
+			/** Estimate a quantile of a histogram.
+			 *
+			 * The values counted in a bucket are taken to be spread evenly across it, so quantiles move smoothly
+			 * within a bucket instead of stepping from one bucket to the next.
+			 *
+			 * @param source Histogram to estimate the quantile of.
+			 * @param p Quantile, from 0.0 to 1.0.
+			 * @param definition Definition of the quantile.
+			 * @return Estimated quantile, 0 if the histogram is empty.
+			 */
+			XMR_UTILITY_PROFILER_LIBRARY_EXPORT double
+				quantile(const histogram& source, double p,
+						 quantile_definition definition = quantile_definition::linear);
+
+			/** Estimate a quantile of a profiler's timings with a confidence interval.
+			 *
+			 * The interval lies between two of the values and holds the true quantile with at least the requested
+			 * confidence, whatever the distribution. It is exact for tail quantiles, where few values lie beyond the
+			 * quantile, and uses the normal approximation otherwise.
+			 *
+			 * @param source Profiler to estimate the quantile of.
+			 * @param p Quantile, from 0.0 to 1.0.
+			 * @param confidence Confidence level of the interval, for example 0.95.
+			 * @param definition Definition of the quantile.
+			 * @return Estimated quantile and interval, all 0 if nothing was tracked.
+			 */
+			XMR_UTILITY_PROFILER_LIBRARY_EXPORT quantile_estimate
+				quantile(xmr::utility::profiler::profiler& source, double p, double confidence,
+						 quantile_definition definition = quantile_definition::linear);
+
+			/** Estimate a quantile of a histogram with a confidence interval.
+			 *
+			 * @param source Histogram to estimate the quantile of.
+			 * @param p Quantile, from 0.0 to 1.0.
+			 * @param confidence Confidence level of the interval, for example 0.95.
+			 * @param definition Definition of the quantile.
+			 * @return Estimated quantile and interval, all 0 if the histogram is empty.
+			 */
+			XMR_UTILITY_PROFILER_LIBRARY_EXPORT quantile_estimate
+				quantile(const histogram& source, double p, double confidence,
+						 quantile_definition definition = quantile_definition::linear);
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
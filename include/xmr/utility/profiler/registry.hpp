@@ -0,0 +1,159 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_REGISTRY_HPP
+#define XMR_UTILITY_PROFILER_REGISTRY_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <atomic>
+
+// ELF linkers generate __start_ and __stop_ symbols around sections named like C identifiers, which lets the library
+// find every statically declared zone at startup without running any code at its declaration.
+#if defined(__ELF__) && (defined(__GNUC__) || defined(__clang__))
+#define XMR_UTILITY_PROFILER_ZONE_SECTION 1
+// The explicit alignment stops the compiler from over-aligning descriptors, which would leave gaps in the section.
+#define XMR_UTILITY_PROFILER_ZONE_SECTION_ATTRIBUTE \
+	__attribute__((section("xmr_utility_profiler_zones"), used,  \
+				   aligned(__alignof__(::xmr::utility::profiler::registry::descriptor))))
+#else
+#define XMR_UTILITY_PROFILER_ZONE_SECTION_ATTRIBUTE
+#endif
+
+/** Declare a static zone.
+ *
+ * On ELF platforms zones in the module that links the library are registered before main() runs. Elsewhere, and in
+ * other shared objects, they are registered on first use.
+ *
+ * @param VARIABLE Name of the static registry::descriptor to declare.
+ * @param NAME Name of the zone, must be a string literal.
+ */
+#define XMR_UTILITY_PROFILER_ZONE(VARIABLE, NAME)                                                                      \
+	static ::xmr::utility::profiler::registry::descriptor VARIABLE XMR_UTILITY_PROFILER_ZONE_SECTION_ATTRIBUTE = {     \
+		NAME, __FILE__, __LINE__, {::xmr::utility::profiler::registry::invalid_zone}}
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			namespace registry {
+				/** Identifier of a zone that is invalid or unknown.
+				 */
+				static const uint32_t invalid_zone = 0xFFFFFFFFul;
+
+				/** Maximum number of zones in the process, including the overflow zone.
+				 */
+				static const uint32_t capacity = 16384;
+
+				/** Find or create a zone by name.
+				 *
+				 * Zones are never removed, so the returned identifier remains valid for the lifetime of the process.
+				 * Looking up an existing name never takes a lock or waits, but still hashes and compares the name, so
+				 * callers should cache the identifier instead of looking it up on every use.
+				 *
+				 * Once zone() created limit() zones, or the capacity is used up, new names are folded into the overflow
+				 * zone instead.
+				 *
+				 * @param name Name of the zone, copied on first registration.
+				 * @return Dense identifier of the zone, starting at 0.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT uint32_t zone(const char* name);
+
+				/** Find or create a zone by a name that is not null terminated.
+				 *
+				 * @param name Name of the zone, copied on first registration.
+				 * @param length Length of the name in bytes.
+				 * @return Dense identifier of the zone, starting at 0.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT uint32_t zone(const char* name, size_t length);
+
+				/** Get the name of a zone.
+				 *
+				 * @param id Identifier of the zone.
+				 * @return Name of the zone, or nullptr if the identifier is unknown.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT const char* name(uint32_t id);
+
+				/** Get the number of registered zones.
+				 *
+				 * @return Number of registered zones, which is also one past the highest identifier.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT uint32_t count();
+
+				/** Limit the number of zones that zone() may create.
+				 *
+				 * Guards against names with unbounded cardinality, such as ones built from user input. Zones that
+				 * already exist keep their identifier. Static zones neither count against nor are subject to it.
+				 *
+				 * @param zones Maximum number of zones, at most capacity - 1.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void limit(uint32_t zones);
+
+				/** Get the zone that names beyond the limit are folded into.
+				 *
+				 * @return Identifier of the zone named "(overflow)".
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT uint32_t overflow();
+
+				/** Get the number of lookups that were folded into the overflow zone.
+				 *
+				 * @return Number of folded lookups since the start of the process.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT uint64_t overflowed();
+
+				/** Statically declared zone, see XMR_UTILITY_PROFILER_ZONE.
+				 */
+				struct descriptor {
+					const char*           name;
+					const char*           file;
+					uint32_t              line;
+					std::atomic<uint32_t> id; // Assigned by enumerate(), or on first use if not enumerated.
+				};
+
+				/** Register a range of static zones in one pass.
+				 *
+				 * Called automatically at startup for the zone section of the module that links the library. Calling it
+				 * again for an already registered range does nothing.
+				 *
+				 * @param begin First descriptor of the range.
+				 * @param end One past the last descriptor of the range.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void enumerate(descriptor* begin, descriptor* end);
+
+				/** Get the identifier of a static zone.
+				 *
+				 * Identifiers are dense, so they can index flat per-thread arrays of count() entries. Zones that were
+				 * enumerated cost a single load and compare, all others are registered here on first use.
+				 *
+				 * @param zone Descriptor declared with XMR_UTILITY_PROFILER_ZONE.
+				 * @return Identifier of the zone.
+				 */
+				inline uint32_t id(descriptor& zone)
+				{
+					uint32_t value = zone.id.load(std::memory_order_relaxed);
+					if (value == invalid_zone) {
+						registry::enumerate(&zone, &zone + 1);
+						value = zone.id.load(std::memory_order_relaxed);
+					}
+					return value;
+				}
+			} // namespace registry
+
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
@@ -0,0 +1,179 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_REPORTER_HPP
+#define XMR_UTILITY_PROFILER_REPORTER_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "xmr/utility/profiler/histogram.hpp"
+#include "xmr/utility/profiler/profiler.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Parallel Report Pipeline
+			 *
+			 * Merges many profilers and histograms into one set of statistics per zone, for example the per-thread
+			 * shards of every zone in the process. Zones are split into chunks that are handed out to a small pool of
+			 * worker threads, plus the calling thread. Each zone's sources are merged into a log-linear layout and
+			 * reduced to count, sum, minimum, maximum and quantiles in one pass.
+			 *
+			 * Results are handed to the callback on the calling thread in ascending zone order, as soon as the chunk
+			 * containing them is done. The output is therefore identical no matter how many threads are used, while
+			 * writing it overlaps with merging the remaining chunks.
+			 *
+			 * Quantiles are accurate to the precision of the layout, minimum, maximum and the sum of profiler
+			 * timings are exact.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT reporter {
+				struct zone_sources {
+					uint32_t                                       zone;
+					std::vector<xmr::utility::profiler::profiler*> timings;
+					std::vector<histogram*>                        buckets;
+				};
+
+				struct worker;
+
+				public:
+				/** Merged statistics of a single zone.
+				 */
+				struct report {
+					uint32_t        zone;
+					uint64_t        count;
+					double          sum;
+					uint64_t        minimum; // 0 if count is 0.
+					uint64_t        maximum; // 0 if count is 0.
+					const uint64_t* values;  // One value per quantile, in the order of quantiles().
+				};
+
+				/** Function called for each zone, in ascending zone order.
+				 */
+				typedef std::function<void(const report&)> callback_t;
+
+				private:
+				std::mutex                               _run_lock; // Serializes run() against changes of the sources.
+				std::vector<zone_sources>                _zones;    // Sorted by zone.
+				std::vector<double>                      _quantiles;
+				uint32_t                                 _precision;
+				size_t                                   _chunk;
+				std::vector<report>                      _reports;
+				std::vector<uint64_t>                    _values;
+				std::unique_ptr<std::atomic<uint64_t>[]> _ready; // Generation each chunk was last finished in.
+				size_t                                   _ready_count;
+
+				std::mutex                           _lock; // Protects the fields below, and wakes the threads.
+				std::condition_variable              _signal;
+				std::condition_variable              _done;
+				bool                                 _stop;
+				uint64_t                             _generation; // Incremented by every run().
+				size_t                               _active;     // Worker threads taking part in the current run.
+				std::atomic<size_t>                  _chunks;     // Read by workers without the lock.
+				std::atomic<uint64_t>                _next;       // Generation and next chunk, 32 bits each.
+				std::vector<std::unique_ptr<worker>> _workers;
+				std::vector<std::thread>             _threads;
+
+				public:
+				~reporter();
+
+				/** Create a new reporter and start its worker threads.
+				 *
+				 * @param quantiles Quantiles (as 0.0 - 1.0) to compute for every zone.
+				 * @param precision Number of bits of precision of the merged layout, from 1 to 20, see histogram.
+				 * @param threads Number of worker threads in addition to the calling thread, or -1 for one less than
+				 *                the number of hardware threads, at most 7.
+				 * @param chunk Number of zones handed to a thread at once.
+				 */
+				reporter(const std::vector<double>& quantiles = {0.5, 0.9, 0.99, 0.999}, uint32_t precision = 8,
+						 size_t threads = size_t(-1), size_t chunk = 64);
+
+				reporter(const reporter&) = delete;
+				reporter& operator=(const reporter&) = delete;
+
+				/** Add a profiler to a zone.
+				 *
+				 * A zone may have any number of sources, which are merged when reporting.
+				 *
+				 * @param zone Zone identifier from the registry.
+				 * @param timings Profiler to merge, must outlive the reporter or be removed first.
+				 */
+				void add(uint32_t zone, xmr::utility::profiler::profiler& timings);
+
+				/** Add a histogram to a zone.
+				 *
+				 * Histograms are not safe for concurrent modification, so it must not change while reporting.
+				 *
+				 * @param zone Zone identifier from the registry.
+				 * @param buckets Histogram to merge, must outlive the reporter or be removed first.
+				 */
+				void add(uint32_t zone, histogram& buckets);
+
+				/** Remove a profiler.
+				 *
+				 * @param timings Profiler previously added.
+				 */
+				void remove(xmr::utility::profiler::profiler& timings);
+
+				/** Remove a histogram.
+				 *
+				 * @param buckets Histogram previously added.
+				 */
+				void remove(histogram& buckets);
+
+				/** Merge all zones and report them.
+				 *
+				 * @param callback Function called on the calling thread for each zone with at least one source, in
+				 *                 ascending zone order. The report is only valid during the call.
+				 * @return Number of zones reported.
+				 */
+				size_t run(const callback_t& callback);
+
+				/** Get the quantiles computed for every zone.
+				 *
+				 * @return Quantiles (as 0.0 - 1.0), in the order of report::values.
+				 */
+				const std::vector<double>& quantiles() const
+				{
+					return _quantiles;
+				}
+
+				/** Get the number of worker threads.
+				 *
+				 * @return Number of threads in addition to the calling thread.
+				 */
+				size_t threads() const
+				{
+					return _threads.size();
+				}
+
+				private:
+				void work(size_t index);
+				bool process(worker& state, uint64_t generation);
+				void merge(worker& state, size_t index);
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
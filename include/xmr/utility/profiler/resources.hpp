@@ -0,0 +1,87 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_RESOURCES_HPP
+#define XMR_UTILITY_PROFILER_RESOURCES_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <vector>
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			namespace resources {
+				/** Resource usage of the whole process at one point in time.
+				 *
+				 * Counters only grow, so usage over an interval is the difference between two samples. Fields that
+				 * the platform does not provide stay 0.
+				 */
+				struct sample {
+					uint64_t time;                 // Time the sample was taken, from clock::hpc::now().
+					uint64_t resident;             // Resident set size, in bytes.
+					uint64_t resident_peak;        // Highest resident set size so far, in bytes.
+					uint64_t swapped;              // Memory swapped out, in bytes.
+					uint64_t virtual_size;         // Size of the address space, in bytes.
+					uint64_t user_time;            // CPU time spent in user mode, in nanoseconds.
+					uint64_t system_time;          // CPU time spent in the kernel, in nanoseconds.
+					uint64_t minor_faults;         // Page faults served without I/O.
+					uint64_t major_faults;         // Page faults that required I/O.
+					uint64_t voluntary_switches;   // Context switches while waiting for a resource.
+					uint64_t involuntary_switches; // Context switches due to preemption.
+					uint64_t block_reads;          // Block input operations.
+					uint64_t block_writes;         // Block output operations.
+					uint64_t threads;              // Number of threads.
+				};
+
+				/** Take a sample immediately.
+				 *
+				 * Reads /proc/self/stat and /proc/self/status through descriptors that are opened once and kept
+				 * open, plus getrusage. Nothing is allocated. Elsewhere than on Linux only getrusage is used, and on
+				 * Windows nothing is sampled.
+				 *
+				 * @param result Receives the sample.
+				 * @return true if at least one source could be read, otherwise false.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT bool read(sample& result);
+
+				/** Start a background thread that samples periodically into a ring.
+				 *
+				 * Restarts the thread if it is already running, which also clears the ring. A thread still running
+				 * when the process exits is stopped then.
+				 *
+				 * @param interval Time in nanoseconds between samples, meant to be in the order of seconds.
+				 * @param capacity Number of samples kept, older ones are overwritten.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void start(uint64_t interval, size_t capacity = 600);
+
+				/** Stop the background thread, if running. Samples taken so far are kept.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void stop();
+
+				/** Copy the samples in the ring.
+				 *
+				 * @param samples Receives the samples, oldest first.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void snapshot(std::vector<sample>& samples);
+			} // namespace resources
+
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
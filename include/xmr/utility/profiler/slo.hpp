@@ -0,0 +1,186 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_SLO_HPP
+#define XMR_UTILITY_PROFILER_SLO_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "xmr/utility/profiler/registry.hpp"
+#include "xmr/utility/profiler/trace.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Latency Service Level Objective
+			 *
+			 * Counts events as good if their duration is at or below a threshold, and as bad otherwise. Recording is a
+			 * single compare and increment, everything else happens in update(), which is meant to be called
+			 * periodically from a reporting thread.
+			 *
+			 * For "p99 of handle_request under 2ms" the threshold is 2ms in the unit given to profiler::track, see
+			 * ticks() for the conversion, and the objective is 0.99. A burn rate of 1.0 consumes the error budget exactly over the window, higher
+			 * values consume it faster.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT slo {
+				public:
+				/** Window to compute a burn rate over, with an alert level.
+				 */
+				struct window {
+					uint64_t length; // Length of the window, in the unit given to update().
+					double   level;  // Burn rate at which the callback is invoked, or 0 to never invoke it.
+				};
+
+				/** Current state of an objective, for exporting.
+				 */
+				struct status {
+					uint32_t            zone;
+					uint64_t            threshold;
+					double              objective;
+					uint64_t            good;
+					uint64_t            bad;
+					std::vector<double> burn_rates; // One per window, as of the last update().
+				};
+
+				/** Function called when the burn rate of a window crosses its level, in either direction.
+				 *
+				 * @param objective The objective whose burn rate changed.
+				 * @param window Index of the window.
+				 * @param burn_rate Current burn rate over the window.
+				 * @param above true if the burn rate is now at or above the level, false if it fell below.
+				 */
+				typedef std::function<void(const slo& objective, size_t window, double burn_rate, bool above)>
+					callback_t;
+
+				private:
+				struct sample {
+					uint64_t time;
+					uint64_t good;
+					uint64_t bad;
+				};
+
+				uint32_t              _zone;
+				uint64_t              _threshold;
+				double                _objective;
+				std::atomic<uint64_t> _counts[2]; // Good and bad events.
+
+				std::mutex                                   _lock; // Protects everything below.
+				std::vector<window>                          _windows;
+				std::vector<double>                          _burn_rates;
+				std::vector<bool>                            _above;
+				std::vector<std::unique_ptr<trace::counter>> _counters;
+				std::deque<sample>                           _history;
+				callback_t                                   _callback;
+
+				public:
+				~slo();
+
+				/** Create a new objective.
+				 *
+				 * @param zone Zone identifier from the registry that the objective applies to.
+				 * @param threshold Highest duration that still counts as good.
+				 * @param objective Fraction of events (as 0.0 - 1.0) that must be good.
+				 * @param windows Windows to compute burn rates over, usually a short and a long one.
+				 * @param callback Function called when a burn rate crosses the level of its window.
+				 */
+				slo(uint32_t zone, uint64_t threshold, double objective, const std::vector<window>& windows,
+					const callback_t& callback = callback_t());
+
+				/** Create a new objective with the threshold given as a duration.
+				 *
+				 * The threshold is converted to ticks once, so record() stays a single compare.
+				 *
+				 * @param zone Zone identifier from the registry that the objective applies to.
+				 * @param threshold Highest duration that still counts as good.
+				 * @param frequency Frequency in Hz of the clock that recorded durations are measured with.
+				 * @param objective Fraction of events (as 0.0 - 1.0) that must be good.
+				 * @param windows Windows to compute burn rates over, usually a short and a long one.
+				 * @param callback Function called when a burn rate crosses the level of its window.
+				 */
+				slo(uint32_t zone, std::chrono::nanoseconds threshold, uint64_t frequency, double objective,
+					const std::vector<window>& windows, const callback_t& callback = callback_t());
+
+				slo(const slo&) = delete;
+				slo& operator=(const slo&) = delete;
+
+				/** Convert a duration to ticks of a clock.
+				 *
+				 * @param duration Duration to convert.
+				 * @param frequency Frequency in Hz of the clock, for example clock::tsc::frequency().
+				 * @return Duration in ticks, rounded down.
+				 */
+				static uint64_t ticks(std::chrono::nanoseconds duration, uint64_t frequency);
+
+				/** Count an event as good or bad.
+				 *
+				 * @param duration Duration of the event, for example the return value of profiler::track.
+				 */
+				XMR_UTILITY_PROFILER_INLINE
+				void record(uint64_t duration)
+				{
+					_counts[duration > _threshold ? 1 : 0].fetch_add(1, std::memory_order_relaxed);
+				}
+
+				/** Recompute burn rates and invoke the callback for windows that crossed their level.
+				 *
+				 * Burn rates are also emitted as trace counters in 1/1000 units, if tracing is enabled.
+				 *
+				 * @param now Current time, in the unit of the window lengths. Samples newer than this, as happens if the
+				 *            clock went backwards, count as zero time ago.
+				 */
+				void update(uint64_t now);
+
+				/** Get the zone the objective applies to.
+				 *
+				 * @return Zone identifier from the registry.
+				 */
+				uint32_t zone() const
+				{
+					return _zone;
+				}
+
+				/** Get the burn rate of a window as of the last update().
+				 *
+				 * @param window Index of the window.
+				 * @return Burn rate over the window.
+				 */
+				double burn_rate(size_t window);
+
+				/** Get the current state of the objective.
+				 *
+				 * @param state Receives the state.
+				 */
+				void get(status& state);
+
+				/** Get the current state of all existing objectives.
+				 *
+				 * @param states Receives one state per objective, in order of creation.
+				 */
+				static void snapshot(std::vector<status>& states);
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
@@ -0,0 +1,95 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_SYMBOLIZER_HPP
+#define XMR_UTILITY_PROFILER_SYMBOLIZER_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** In-Process Symbolizer
+			 *
+			 * Resolves code addresses of the current process to function names. Every ELF file mapped into the process
+			 * is read once, and the functions from its .symtab and .dynsym sections are kept in a table sorted by
+			 * address. Unlike dladdr this also finds static functions, as long as the file has not been stripped.
+			 *
+			 * Names are demangled when first asked for and cached afterwards. Only supported on Linux, elsewhere no
+			 * address resolves.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT symbolizer {
+				struct module;
+
+				std::mutex                                   _lock;
+				std::vector<std::unique_ptr<module>>         _modules; // Sorted by start address.
+				std::unordered_map<const char*, std::string> _demangled;
+
+				public:
+				~symbolizer();
+
+				/** Create a new symbolizer and read all currently mapped files.
+				 */
+				symbolizer();
+
+				symbolizer(const symbolizer&) = delete;
+				symbolizer& operator=(const symbolizer&) = delete;
+
+				/** Read files that have been mapped since the last refresh, for example by dlopen.
+				 */
+				void refresh();
+
+				/** Resolve a single address.
+				 *
+				 * @param address Code address in the current process.
+				 * @param name Receives the demangled name of the function containing the address.
+				 * @param offset Receives the offset of the address from the start of the function, if not null.
+				 * @return true if the address was resolved, otherwise false.
+				 */
+				bool resolve(const void* address, std::string& name, uint64_t* offset = nullptr);
+
+				/** Resolve many addresses at once.
+				 *
+				 * Addresses are sorted first, so each module and symbol is looked up only once for all addresses
+				 * that fall into it. Cheaper than calling resolve() for each address of a whole profile.
+				 *
+				 * @param addresses Code addresses in the current process.
+				 * @param names Receives one name per address, empty if it could not be resolved.
+				 */
+				void resolve(const std::vector<const void*>& addresses, std::vector<std::string>& names);
+
+				/** Get the symbolizer shared by the library.
+				 *
+				 * @return Process-wide instance, created on first use.
+				 */
+				static symbolizer& instance();
+
+				private:
+				const char*        find(uintptr_t address, uint64_t* offset);
+				const std::string& demangle(const char* name);
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
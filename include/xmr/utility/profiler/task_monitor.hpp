@@ -0,0 +1,204 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_TASK_MONITOR_HPP
+#define XMR_UTILITY_PROFILER_TASK_MONITOR_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "xmr/utility/profiler/adaptive_histogram.hpp"
+#include "xmr/utility/profiler/clock/hpc.hpp"
+#include "xmr/utility/profiler/histogram.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Thread Pool Task Monitor
+			 *
+			 * Separates the time a task spends queued from the time it spends running. Tasks are wrapped before they
+			 * are handed to any thread pool or queue; the wrapper reads the clock once when it is created, and twice
+			 * when it runs. Queue wait and run time are recorded per task type, where types are zones from the
+			 * registry, and the run time is also added to the busy time of the worker thread that ran the task.
+			 *
+			 * Histograms are adaptive, so rarely used task types stay small, and recording never takes a lock once
+			 * they are dense.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT task_monitor {
+				public:
+				/** Histograms of a single task type.
+				 */
+				struct task_type {
+					uint32_t           zone;
+					adaptive_histogram wait; // Time from wrapping to start, in nanoseconds.
+					adaptive_histogram run;  // Time from start to end, in nanoseconds.
+
+					task_type(uint32_t zone, uint32_t precision) : zone(zone), wait(precision), run(precision) {}
+				};
+
+				/** Merged histograms of a single task type.
+				 */
+				struct type_report {
+					uint32_t  zone;
+					histogram wait;
+					histogram run;
+				};
+
+				/** Usage of a single worker thread.
+				 */
+				struct worker_report {
+					uint32_t thread;      // Sequential number of the thread within the monitor, starting at 1.
+					uint64_t tasks;       // Number of tasks run.
+					uint64_t busy;        // Time spent running tasks, in nanoseconds.
+					uint64_t elapsed;     // Time since the thread first ran a task or the last clear(), in nanoseconds.
+					double   utilization; // busy / elapsed, from 0 to 1.
+				};
+
+				/** Task wrapped for submission, see wrap().
+				 */
+				template<typename F>
+				class task {
+					task_monitor* _monitor;
+					task_type*    _type;
+					uint64_t      _enqueued;
+					F             _function;
+
+					// Records the run even if the task throws.
+					struct execution {
+						task&    owner;
+						uint64_t start;
+
+						~execution()
+						{
+							owner._monitor->finish(*owner._type, start, clock::hpc::now());
+						}
+					};
+
+					public:
+					task(task_monitor& monitor, task_type& type, F function)
+						: _monitor(&monitor), _type(&type), _enqueued(clock::hpc::now()), _function(std::move(function))
+					{}
+
+					/** Run the task, recording the time it waited and ran.
+					 *
+					 * @param arguments Passed on to the wrapped function.
+					 * @return Result of the wrapped function.
+					 */
+					template<typename... Args>
+					auto operator()(Args&&... arguments)
+						-> decltype(std::declval<F&>()(std::forward<Args>(arguments)...))
+					{
+						uint64_t start = clock::hpc::now();
+						_type->wait.record(start >= _enqueued ? (start - _enqueued) : 0);
+						execution guard = {*this, start};
+						return _function(std::forward<Args>(arguments)...);
+					}
+				};
+
+				private:
+				struct worker;
+
+				uint64_t                                   _serial; // Distinguishes monitors in per-thread caches.
+				uint32_t                                   _precision;
+				std::unique_ptr<std::atomic<task_type*>[]> _types; // Indexed by zone, filled on first use.
+				std::mutex                                 _lock;  // Protects the fields below.
+				std::vector<std::unique_ptr<task_type>>    _owned;
+				std::vector<std::unique_ptr<worker>>       _workers;
+
+				public:
+				~task_monitor();
+
+				/** Create a new task monitor.
+				 *
+				 * @param precision Number of bits of precision of the histograms, see histogram.
+				 */
+				task_monitor(uint32_t precision = 8);
+
+				task_monitor(const task_monitor&) = delete;
+				task_monitor& operator=(const task_monitor&) = delete;
+
+				/** Get the histograms of a task type, creating them on first use.
+				 *
+				 * Never takes a lock once the type exists. The result remains valid for the lifetime of the monitor,
+				 * so it can be kept to skip the lookup when wrapping.
+				 *
+				 * @param zone Zone identifier from the registry naming the task type.
+				 * @return Histograms of the task type.
+				 */
+				task_type& get(uint32_t zone);
+
+				/** Wrap a task for submission, reading the clock once.
+				 *
+				 * @param type Task type from get().
+				 * @param function Function to run, moved or copied into the wrapper.
+				 * @return Callable to submit instead of the function.
+				 */
+				template<typename F>
+				task<typename std::decay<F>::type> wrap(task_type& type, F&& function)
+				{
+					return task<typename std::decay<F>::type>(*this, type, std::forward<F>(function));
+				}
+
+				/** Wrap a task for submission, reading the clock once.
+				 *
+				 * @param zone Zone identifier from the registry naming the task type.
+				 * @param function Function to run, moved or copied into the wrapper.
+				 * @return Callable to submit instead of the function.
+				 */
+				template<typename F>
+				task<typename std::decay<F>::type> wrap(uint32_t zone, F&& function)
+				{
+					return wrap(get(zone), std::forward<F>(function));
+				}
+
+				/** Record a finished task, called by the wrapper.
+				 *
+				 * @param type Type of the task.
+				 * @param start Time the task started, from clock::hpc::now().
+				 * @param end Time the task ended, from clock::hpc::now().
+				 */
+				void finish(task_type& type, uint64_t start, uint64_t end);
+
+				/** Copy the histograms of all task types.
+				 *
+				 * @param reports Receives one entry per task type, sorted by zone.
+				 */
+				void collect(std::vector<type_report>& reports);
+
+				/** Copy the usage of all worker threads.
+				 *
+				 * @param reports Receives one entry per thread that ran a task, in order of their first task.
+				 */
+				void workers(std::vector<worker_report>& reports);
+
+				/** Remove all counts, and restart the utilization of every worker thread.
+				 */
+				void clear();
+
+				private:
+				worker& local(uint64_t now);
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
@@ -0,0 +1,175 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_THROUGHPUT_HPP
+#define XMR_UTILITY_PROFILER_THROUGHPUT_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <atomic>
+#include "xmr/utility/profiler/adaptive_histogram.hpp"
+#include "xmr/utility/profiler/histogram.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			/** Work-Normalized Throughput Profiler
+			 *
+			 * Profiles zones whose duration depends on the amount of work, such as compressing or parsing a buffer.
+			 * Each event is recorded with the number of units it processed, for example bytes or items, and its time
+			 * per unit is counted in a histogram. Throughput percentiles are derived from it when reporting.
+			 *
+			 * Time per unit is kept in nanoseconds as fixed point with fraction_bits bits after the point, so that
+			 * fast zones below a nanosecond per unit keep their resolution. It is computed without division, by
+			 * multiplying with a reciprocal of the units looked up from their highest bits, which adds a relative
+			 * error below 0.1%.
+			 */
+			class XMR_UTILITY_PROFILER_LIBRARY_EXPORT throughput {
+				public:
+				/** Number of fractional bits of the time per unit.
+				 */
+				static const uint32_t fraction_bits = 16;
+
+				private:
+				adaptive_histogram    _cost; // Time per unit, in fixed point.
+				std::atomic<uint64_t> _events;
+				std::atomic<uint64_t> _time;
+				std::atomic<uint64_t> _units;
+
+				public:
+				~throughput();
+
+				/** Create a new throughput profiler.
+				 *
+				 * @param precision Number of bits of precision of the time per unit, see histogram.
+				 */
+				throughput(uint32_t precision = 8);
+
+				throughput(const throughput&) = delete;
+				throughput& operator=(const throughput&) = delete;
+
+				/** Track a profiled event that processed some amount of work.
+				 *
+				 * @param time_end The end time recorded for the event.
+				 * @param time_start The start time recorded for the event.
+				 * @param units Amount of work processed, for example bytes. Events without work only count towards
+				 *              the totals.
+				 * @return Difference between time_end and time_start.
+				 */
+				uint64_t track(uint64_t time_end, uint64_t time_start, uint64_t units);
+
+				/** Record an event that processed some amount of work.
+				 *
+				 * @param time Time the event took, in nanoseconds.
+				 * @param units Amount of work processed.
+				 */
+				void record(uint64_t time, uint64_t units);
+
+				/** Remove all recorded events.
+				 */
+				void clear();
+
+				/** Add the time per unit of all events to a histogram.
+				 *
+				 * @param target Histogram to add to, values are nanoseconds per unit in fixed point.
+				 */
+				void snapshot(histogram& target);
+
+				/** Get the precision of the time per unit.
+				 *
+				 * @return Number of bits of precision, see histogram.
+				 */
+				uint32_t precision() const
+				{
+					return _cost.precision();
+				}
+
+				public /*Statistics*/:
+
+				/** Get the total number of profiled events.
+				 *
+				 * @return Total number of profiled events.
+				 */
+				uint64_t total_events() const
+				{
+					return _events.load(std::memory_order_relaxed);
+				}
+
+				/** Get the total time spent in events.
+				 *
+				 * @return Total time spent in events, in nanoseconds.
+				 */
+				uint64_t total_time() const
+				{
+					return _time.load(std::memory_order_relaxed);
+				}
+
+				/** Get the total amount of work processed.
+				 *
+				 * @return Total number of units.
+				 */
+				uint64_t total_units() const
+				{
+					return _units.load(std::memory_order_relaxed);
+				}
+
+				/** Get the overall throughput, total units over total time.
+				 *
+				 * @return Units per second, or 0 if no time was recorded.
+				 */
+				double average_throughput() const;
+
+				/** Percentile (by time per unit)
+				 *
+				 * @param percentile The percentile (as 0.0 - 1.0) to find a match for.
+				 * @return Time per unit in nanoseconds that the given share of events took at most.
+				 */
+				double percentile_cost(double percentile);
+
+				/** Percentile (by throughput)
+				 *
+				 * Slow events are the interesting ones, so percentiles count from the fastest event: the 0.99
+				 * percentile is the throughput that 99% of events reached or exceeded.
+				 *
+				 * @param percentile The percentile (as 0.0 - 1.0) to find a match for.
+				 * @return Units per second that the given share of events reached, or 0 if there are none.
+				 */
+				double percentile_throughput(double percentile);
+
+				/** Percentile (by time per unit) of a snapshot
+				 *
+				 * Lets several percentiles be taken from a single snapshot.
+				 *
+				 * @param costs Histogram filled by snapshot().
+				 * @param percentile The percentile (as 0.0 - 1.0) to find a match for.
+				 * @return Time per unit in nanoseconds that the given share of events took at most.
+				 */
+				static double percentile_cost(const histogram& costs, double percentile);
+
+				/** Percentile (by throughput) of a snapshot
+				 *
+				 * @param costs Histogram filled by snapshot().
+				 * @param percentile The percentile (as 0.0 - 1.0) to find a match for.
+				 * @return Units per second that the given share of events reached, or 0 if there are none.
+				 */
+				static double percentile_throughput(const histogram& costs, double percentile);
+			};
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
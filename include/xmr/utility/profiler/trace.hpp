@@ -0,0 +1,248 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_TRACE_HPP
+#define XMR_UTILITY_PROFILER_TRACE_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include "xmr/utility/profiler/registry.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			namespace trace {
+				/** Kind of a trace record.
+				 */
+				enum class type : uint8_t {
+					begin,      // Start of a slice.
+					end,        // End of a slice.
+					flow_begin, // Producer side of a flow, payload is the flow id.
+					flow_step,  // Intermediate step of a flow, payload is the flow id.
+					flow_end,   // Consumer side of a flow, payload is the flow id.
+					counter,    // New value of a counter track, payload is the value as int64_t.
+				};
+
+				/** Single entry in a per-thread trace buffer.
+				 */
+				struct record {
+					uint64_t timestamp; // Time in nanoseconds, see clock::hpc.
+					uint64_t payload;   // Meaning depends on type.
+					uint32_t zone;      // Zone identifier from the registry.
+					type     kind;
+				};
+
+				/** Start recording trace events.
+				 *
+				 * Each thread allocates its own buffer on the first record after this call. Once a buffer is full,
+				 * further records from that thread are dropped and counted instead. Buffers are allocated once per
+				 * thread and never resized, so threads that already have one keep its capacity when tracing is
+				 * enabled again.
+				 *
+				 * @param capacity Number of records each new thread buffer can hold.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void enable(size_t capacity = 1048576);
+
+				/** Stop recording trace events.
+				 *
+				 * Already recorded events are kept until clear() is called.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void disable();
+
+				/** Check if trace events are being recorded.
+				 *
+				 * @return true if enabled, otherwise false.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT bool is_enabled();
+
+				/** Discard all recorded trace events.
+				 *
+				 * Must not be called while other threads are recording.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void clear();
+
+				/** Get the number of records dropped due to full buffers.
+				 *
+				 * @return Number of dropped records across all threads.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT uint64_t dropped();
+
+				/** Append a record to the buffer of the calling thread.
+				 *
+				 * Does nothing if tracing is disabled.
+				 *
+				 * @param kind Kind of the record.
+				 * @param zone Zone identifier from the registry.
+				 * @param payload Additional data, meaning depends on kind.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void emit(type kind, uint32_t zone, uint64_t payload = 0);
+
+				/** Write all recorded events in the Chrome Trace Event format.
+				 *
+				 * The output can be loaded into chrome://tracing or the Perfetto UI.
+				 *
+				 * @param file File to write to.
+				 * @return true if everything was written, otherwise false.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT bool write_chrome(std::FILE* file);
+
+				/** Begin a slice on the calling thread.
+				 *
+				 * @param zone Zone identifier from the registry.
+				 */
+				inline void begin(uint32_t zone)
+				{
+					emit(type::begin, zone);
+				}
+
+				/** End a slice on the calling thread.
+				 *
+				 * @param zone Zone identifier from the registry, must match the one given to begin().
+				 */
+				inline void end(uint32_t zone)
+				{
+					emit(type::end, zone);
+				}
+
+				/** Begin a flow from the current slice, usually on the producer thread.
+				 *
+				 * The flow is drawn as an arrow from the enclosing slice to the slices that step or end it.
+				 *
+				 * @param id Identifier of the flow, must be unique among active flows with the same zone.
+				 * @param zone Zone identifier used to name the flow.
+				 */
+				inline void flow_begin(uint64_t id, uint32_t zone)
+				{
+					emit(type::flow_begin, zone, id);
+				}
+
+				/** Continue a flow in the current slice.
+				 *
+				 * @param id Identifier of the flow, as given to flow_begin().
+				 * @param zone Zone identifier used to name the flow, as given to flow_begin().
+				 */
+				inline void flow_step(uint64_t id, uint32_t zone)
+				{
+					emit(type::flow_step, zone, id);
+				}
+
+				/** End a flow in the current slice, usually on the consumer thread.
+				 *
+				 * @param id Identifier of the flow, as given to flow_begin().
+				 * @param zone Zone identifier used to name the flow, as given to flow_begin().
+				 */
+				inline void flow_end(uint64_t id, uint32_t zone)
+				{
+					emit(type::flow_end, zone, id);
+				}
+
+				/** Scoped slice
+				 *
+				 * Begins a slice on construction and ends it on destruction.
+				 */
+				class scope {
+					uint32_t _zone;
+
+					public:
+					scope(uint32_t zone) : _zone(zone)
+					{
+						begin(_zone);
+					}
+
+					~scope()
+					{
+						end(_zone);
+					}
+
+					scope(const scope&) = delete;
+					scope& operator=(const scope&) = delete;
+				};
+
+				/** Counter track
+				 *
+				 * Plots a value such as queue depth or memory usage against the slices on the timeline. Setting the
+				 * same value again is not recorded, so it is cheap to update a counter on every iteration of a loop.
+				 * Deduplication is shared by all threads updating the counter, and updates are serialized so the
+				 * track always ends on the value set last.
+				 *
+				 * After clear(), the track only reappears once the value changes.
+				 */
+				class counter {
+					uint32_t          _zone;
+					std::atomic<bool> _lock; // Orders the timestamps of concurrent updates.
+					bool              _known;
+					int64_t           _last;
+
+					public:
+					/** Create a counter track.
+					 *
+					 * @param zone Zone identifier from the registry, used to name the track.
+					 */
+					counter(uint32_t zone) : _zone(zone), _lock(false), _known(false), _last(0) {}
+
+					/** Create a counter track.
+					 *
+					 * @param name Name of the track, registered as a zone.
+					 */
+					counter(const char* name) : counter(registry::zone(name)) {}
+
+					counter(const counter&) = delete;
+					counter& operator=(const counter&) = delete;
+
+					/** Set the current value of the counter.
+					 *
+					 * @param value New value, recorded only if it differs from the previous one.
+					 */
+					void set(int64_t value)
+					{
+						if (!is_enabled()) {
+							return;
+						}
+
+						// Held only for a few instructions, so a mutex would mostly cost memory.
+						while (_lock.exchange(true, std::memory_order_acquire)) {
+							while (_lock.load(std::memory_order_relaxed)) {
+								std::this_thread::yield();
+							}
+						}
+						if (!_known || (_last != value)) {
+							_known = true;
+							_last  = value;
+							emit(type::counter, _zone, static_cast<uint64_t>(value));
+						}
+						_lock.store(false, std::memory_order_release);
+					}
+
+					/** Get the zone identifier used to name the track.
+					 *
+					 * @return Zone identifier from the registry.
+					 */
+					uint32_t zone() const
+					{
+						return _zone;
+					}
+				};
+			} // namespace trace
+
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
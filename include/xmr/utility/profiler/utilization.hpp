@@ -0,0 +1,85 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_UTILIZATION_HPP
+#define XMR_UTILITY_PROFILER_UTILIZATION_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <cstdio>
+#include <vector>
+
+/* Per-thread utilization
+ *
+ * A thread counts as busy while it is inside a top-level zone opened with active::push() or active::scope. A
+ * background thread samples the busy time of every thread at a fixed interval and stores the share of the interval
+ * spent busy as a percentage in a small ring per thread. Comparing the rings of a pool's workers shows whether work
+ * is spread evenly, without recording a full trace.
+ */
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			namespace utilization {
+				/** Utilization history of a single thread.
+				 */
+				struct series {
+					uint32_t             thread;  // Sequential number of the thread, see active::stack.
+					uint64_t             busy;    // Busy time since the thread was first sampled, in nanoseconds.
+					uint64_t             elapsed; // Time since the thread was first sampled, in nanoseconds.
+					uint64_t             time;    // Time of the newest sample, from clock::hpc::now().
+					std::vector<uint8_t> samples; // Busy share of each interval in percent, oldest first.
+				};
+
+				/** Start a background thread that samples the utilization of all threads.
+				 *
+				 * Enables busy time accounting, see active::account(). While tracing is enabled, every sample is
+				 * also recorded as a counter track named "utilization thread N". Restarts the thread if it is
+				 * already running, which also clears all history. A thread still running when the process exits is
+				 * stopped then.
+				 *
+				 * @param interval Time in nanoseconds between samples.
+				 * @param capacity Number of samples kept per thread, older ones are overwritten.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void start(uint64_t interval, size_t capacity = 600);
+
+				/** Stop the background thread and busy time accounting, if running. History is kept.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void stop();
+
+				/** Copy the utilization history of all sampled threads.
+				 *
+				 * @param history Receives one entry per thread, ordered by thread number.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void snapshot(std::vector<series>& history);
+
+				/** Write a table of the utilization of every sampled thread.
+				 *
+				 * Lists the average over the whole time a thread was sampled, and the lowest, highest and newest
+				 * sample kept in its ring.
+				 *
+				 * @param file File to write to.
+				 * @return true if everything was written, otherwise false.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT bool write_report(std::FILE* file);
+			} // namespace utilization
+
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
@@ -0,0 +1,81 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#ifndef XMR_UTILITY_PROFILER_WATCHDOG_HPP
+#define XMR_UTILITY_PROFILER_WATCHDOG_HPP
+#pragma once
+#include "xmr/utility/profiler/config.hpp"
+
+#include <functional>
+#include "xmr/utility/profiler/active.hpp"
+
+namespace xmr {
+	namespace utility {
+		namespace profiler {
+			namespace watchdog {
+				/** Zone that has been open for longer than the threshold.
+				 */
+				struct report {
+					const active::stack* stack;    // Active zones of the thread, outermost first.
+					size_t               index;    // Index of the outermost zone in the stack over the threshold.
+					uint64_t             duration; // Time in nanoseconds that zone has been open for.
+				};
+
+				/** Function called for each stuck zone.
+				 */
+				typedef std::function<void(const report&)> callback_t;
+
+				/** Write a report to stderr, including the names of all zones on the stack.
+				 *
+				 * This is the default callback.
+				 *
+				 * @param stuck Report to write.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void print(const report& stuck);
+
+				/** Check all threads for zones open longer than the threshold.
+				 *
+				 * Each stuck zone is reported once per scan. Use start() to report each only once.
+				 *
+				 * @param threshold Time in nanoseconds after which a zone is considered stuck.
+				 * @param callback Function called for each thread with a stuck zone.
+				 * @return Number of threads with a stuck zone.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT size_t scan(uint64_t threshold, const callback_t& callback = print);
+
+				/** Start a background thread that periodically scans for stuck zones.
+				 *
+				 * A zone is reported once, even if it stays open across several scans. Restarts the thread if it is
+				 * already running. A thread still running when the process exits is stopped then.
+				 *
+				 * @param threshold Time in nanoseconds after which a zone is considered stuck.
+				 * @param interval Time in nanoseconds between scans.
+				 * @param callback Function called for each newly stuck zone, from the watchdog thread.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void start(uint64_t threshold, uint64_t interval,
+															   const callback_t& callback = print);
+
+				/** Stop the background thread, if running.
+				 */
+				XMR_UTILITY_PROFILER_LIBRARY_EXPORT void stop();
+			} // namespace watchdog
+
+		} // namespace profiler
+
+	} // namespace utility
+
+} // namespace xmr
+
+#endif
@@ -0,0 +1,212 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/active.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+using namespace xmr::utility::profiler;
+
+/** Active zones of a single thread.
+ *
+ * Only the owning thread writes, guarded by a sequence counter that is odd while a write is in progress. Readers
+ * copy the slots and retry if the sequence changed in the meantime, so writers never wait on readers.
+ */
+struct active_stack {
+	std::atomic<uint32_t> sequence;
+	std::atomic<size_t>   depth;
+	std::atomic<uint32_t> zones[active::max_depth];
+	std::atomic<uint64_t> starts[active::max_depth];
+	std::atomic<uint64_t> busy; // Time spent in closed top-level zones, while accounting was enabled.
+	std::atomic<bool>     used;
+	uint32_t              thread;
+};
+
+static std::atomic<bool> active_accounting(false);
+
+// Stacks are recycled when their thread exits, so the list only grows with the peak number of threads.
+static std::mutex& active_lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+static std::vector<std::unique_ptr<active_stack>>& active_stacks()
+{
+	static std::vector<std::unique_ptr<active_stack>> stacks;
+	return stacks;
+}
+
+struct active_owner {
+	active_stack* stack = nullptr;
+
+	~active_owner()
+	{
+		if (stack) {
+			stack->depth.store(0, std::memory_order_relaxed);
+			stack->used.store(false, std::memory_order_release);
+		}
+	}
+};
+
+static thread_local active_owner active_local;
+
+static active_stack* active_acquire()
+{
+	if (active_local.stack) {
+		return active_local.stack;
+	}
+
+	std::lock_guard<std::mutex> l(active_lock());
+	auto&                       stacks = active_stacks();
+	for (auto& stack : stacks) {
+		if (!stack->used.load(std::memory_order_acquire)) {
+			stack->used.store(true, std::memory_order_relaxed);
+			active_local.stack = stack.get();
+			return active_local.stack;
+		}
+	}
+
+	std::unique_ptr<active_stack> stack(new active_stack());
+	stack->sequence.store(0, std::memory_order_relaxed);
+	stack->depth.store(0, std::memory_order_relaxed);
+	stack->busy.store(0, std::memory_order_relaxed);
+	stack->used.store(true, std::memory_order_relaxed);
+	stack->thread      = static_cast<uint32_t>(stacks.size() + 1);
+	active_local.stack = stack.get();
+	stacks.push_back(std::move(stack));
+	return active_local.stack;
+}
+
+void xmr::utility::profiler::active::push(uint32_t zone, uint64_t now)
+{
+	active_stack* stack    = active_acquire();
+	uint32_t      sequence = stack->sequence.load(std::memory_order_relaxed);
+	size_t        depth    = stack->depth.load(std::memory_order_relaxed);
+
+	stack->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	if (depth < max_depth) {
+		stack->zones[depth].store(zone, std::memory_order_relaxed);
+		stack->starts[depth].store(now, std::memory_order_relaxed);
+	}
+	stack->depth.store(depth + 1, std::memory_order_relaxed);
+	stack->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void xmr::utility::profiler::active::pop()
+{
+	active_stack* stack    = active_acquire();
+	uint32_t      sequence = stack->sequence.load(std::memory_order_relaxed);
+	size_t        depth    = stack->depth.load(std::memory_order_relaxed);
+	if (depth == 0) {
+		return;
+	}
+
+	// Leaving the outermost zone ends a busy period of the thread.
+	uint64_t busy = 0;
+	if ((depth == 1) && active_accounting.load(std::memory_order_relaxed)) {
+		uint64_t start = stack->starts[0].load(std::memory_order_relaxed);
+		uint64_t now   = clock::hpc::now();
+		busy           = now > start ? (now - start) : 0;
+	}
+
+	stack->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	if (busy != 0) {
+		stack->busy.store(stack->busy.load(std::memory_order_relaxed) + busy, std::memory_order_relaxed);
+	}
+	stack->depth.store(depth - 1, std::memory_order_relaxed);
+	stack->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void xmr::utility::profiler::active::account(bool enabled)
+{
+	active_accounting.store(enabled, std::memory_order_relaxed);
+}
+
+void xmr::utility::profiler::active::usage(std::vector<thread_usage>& usage, uint64_t now)
+{
+	usage.clear();
+
+	bool                        accounting = active_accounting.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> l(active_lock());
+	for (auto& source : active_stacks()) {
+		if (!source->used.load(std::memory_order_acquire)) {
+			continue;
+		}
+
+		thread_usage entry;
+		entry.thread = source->thread;
+		while (true) {
+			uint32_t before = source->sequence.load(std::memory_order_acquire);
+			if ((before & 1) != 0) {
+				continue;
+			}
+
+			size_t   depth = source->depth.load(std::memory_order_relaxed);
+			uint64_t start = source->starts[0].load(std::memory_order_relaxed);
+			entry.busy     = source->busy.load(std::memory_order_relaxed);
+			if (accounting && (depth > 0) && (now > start)) {
+				entry.busy += now - start;
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (source->sequence.load(std::memory_order_relaxed) == before) {
+				break;
+			}
+		}
+		usage.push_back(entry);
+	}
+}
+
+void xmr::utility::profiler::active::snapshot(std::vector<stack>& stacks)
+{
+	stacks.clear();
+
+	std::lock_guard<std::mutex> l(active_lock());
+	for (auto& source : active_stacks()) {
+		if (!source->used.load(std::memory_order_acquire)) {
+			continue;
+		}
+
+		stack copy;
+		copy.thread = source->thread;
+		while (true) {
+			uint32_t before = source->sequence.load(std::memory_order_acquire);
+			if ((before & 1) != 0) {
+				continue;
+			}
+
+			copy.depth = source->depth.load(std::memory_order_relaxed);
+			copy.entries.resize(copy.depth < max_depth ? copy.depth : max_depth);
+			for (size_t idx = 0; idx < copy.entries.size(); idx++) {
+				copy.entries[idx].zone  = source->zones[idx].load(std::memory_order_relaxed);
+				copy.entries[idx].start = source->starts[idx].load(std::memory_order_relaxed);
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (source->sequence.load(std::memory_order_relaxed) == before) {
+				break;
+			}
+		}
+
+		if (copy.depth > 0) {
+			stacks.push_back(std::move(copy));
+		}
+	}
+}
@@ -0,0 +1,179 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/adaptive_histogram.hpp"
+#include "xmr/utility/profiler/profiler.hpp"
+
+#include <memory>
+#include <thread>
+
+xmr::utility::profiler::adaptive_histogram::~adaptive_histogram()
+{
+	delete[] _dense.load(std::memory_order_relaxed);
+}
+
+xmr::utility::profiler::adaptive_histogram::adaptive_histogram(uint32_t precision)
+	: _dense(nullptr), _lock(false), _precision(), _sparse_size(0), _sparse_buckets(), _sparse_counts()
+{
+	if (precision < 1) {
+		precision = 1;
+	} else if (precision > 20) {
+		precision = 20;
+	}
+	_precision = precision;
+}
+
+uint64_t xmr::utility::profiler::adaptive_histogram::track(uint64_t time_end, uint64_t time_start)
+{
+	uint64_t difference = elapsed(time_end, time_start);
+
+	record(difference);
+	return difference;
+}
+
+void xmr::utility::profiler::adaptive_histogram::record_sparse(uint32_t bucket, uint64_t count)
+{
+	lock();
+
+	// Someone else may have promoted the histogram while we were waiting for the lock.
+	std::atomic<uint64_t>* dense = _dense.load(std::memory_order_relaxed);
+	if (dense) {
+		unlock();
+		dense[bucket].fetch_add(count, std::memory_order_relaxed);
+		return;
+	}
+
+	uint32_t position = 0;
+	while ((position < _sparse_size) && (_sparse_buckets[position] < bucket)) {
+		position++;
+	}
+
+	if ((position < _sparse_size) && (_sparse_buckets[position] == bucket)) {
+		_sparse_counts[position] += count;
+	} else if (_sparse_size < sparse_capacity) {
+		for (uint32_t idx = _sparse_size; idx > position; idx--) {
+			_sparse_buckets[idx] = _sparse_buckets[idx - 1];
+			_sparse_counts[idx]  = _sparse_counts[idx - 1];
+		}
+		_sparse_buckets[position] = bucket;
+		_sparse_counts[position]  = count;
+		_sparse_size++;
+	} else {
+		// Full, so promote. Recorders that see the dense array from here on never touch the sparse one again.
+		dense = new std::atomic<uint64_t>[histogram::size(_precision)]();
+		for (uint32_t idx = 0; idx < _sparse_size; idx++) {
+			dense[_sparse_buckets[idx]].store(_sparse_counts[idx], std::memory_order_relaxed);
+		}
+		dense[bucket].store(dense[bucket].load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+		_sparse_size = 0;
+		_dense.store(dense, std::memory_order_release);
+	}
+
+	unlock();
+}
+
+void xmr::utility::profiler::adaptive_histogram::clear()
+{
+	lock();
+	std::atomic<uint64_t>* dense = _dense.load(std::memory_order_relaxed);
+	if (dense) {
+		size_t size = histogram::size(_precision);
+		for (size_t idx = 0; idx < size; idx++) {
+			dense[idx].store(0, std::memory_order_relaxed);
+		}
+	}
+	_sparse_size = 0;
+	unlock();
+}
+
+void xmr::utility::profiler::adaptive_histogram::snapshot(histogram& target)
+{
+	// Collect into the own layout first, so that resampling works the same for both representations. Only needed
+	// when the precision differs, so a matching target is filled without allocating.
+	std::unique_ptr<histogram> local;
+	if (target.precision() != _precision) {
+		local.reset(new histogram(_precision));
+	}
+	histogram& output = local ? *local : target;
+
+	lock();
+	std::atomic<uint64_t>* dense = _dense.load(std::memory_order_relaxed);
+	if (!dense) {
+		for (uint32_t idx = 0; idx < _sparse_size; idx++) {
+			output.record(histogram::lowest(_sparse_buckets[idx], _precision), _sparse_counts[idx]);
+		}
+	}
+	unlock();
+
+	if (dense) {
+		size_t size = histogram::size(_precision);
+		for (size_t idx = 0; idx < size; idx++) {
+			uint64_t count = dense[idx].load(std::memory_order_relaxed);
+			if (count != 0) {
+				output.record(histogram::lowest(idx, _precision), count);
+			}
+		}
+	}
+
+	if (local) {
+		local->resample(target);
+	}
+}
+
+size_t xmr::utility::profiler::adaptive_histogram::memory() const
+{
+	size_t bytes = sizeof(adaptive_histogram);
+	if (_dense.load(std::memory_order_relaxed)) {
+		bytes += histogram::size(_precision) * sizeof(std::atomic<uint64_t>);
+	}
+	return bytes;
+}
+
+uint64_t xmr::utility::profiler::adaptive_histogram::total_events()
+{
+	uint64_t total = 0;
+
+	lock();
+	std::atomic<uint64_t>* dense = _dense.load(std::memory_order_relaxed);
+	if (!dense) {
+		for (uint32_t idx = 0; idx < _sparse_size; idx++) {
+			total += _sparse_counts[idx];
+		}
+	}
+	unlock();
+
+	if (dense) {
+		size_t size = histogram::size(_precision);
+		for (size_t idx = 0; idx < size; idx++) {
+			total += dense[idx].load(std::memory_order_relaxed);
+		}
+	}
+	return total;
+}
+
+void xmr::utility::profiler::adaptive_histogram::lock()
+{
+	// Held only for a few instructions, and only until promotion, so a mutex would mostly cost memory.
+	while (_lock.exchange(true, std::memory_order_acquire)) {
+		while (_lock.load(std::memory_order_relaxed)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void xmr::utility::profiler::adaptive_histogram::unlock()
+{
+	_lock.store(false, std::memory_order_release);
+}
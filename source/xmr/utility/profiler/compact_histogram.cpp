@@ -0,0 +1,229 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/compact_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+template<typename T>
+static uint64_t compact_histogram_largest(const T* counts, size_t size)
+{
+	T largest = 0;
+	for (size_t idx = 0; idx < size; idx++) {
+		largest = counts[idx] > largest ? counts[idx] : largest;
+	}
+	return largest;
+}
+
+template<typename D, typename S>
+static void compact_histogram_add(D* dst, const S* src, size_t size)
+{
+	for (size_t idx = 0; idx < size; idx++) {
+		dst[idx] = static_cast<D>(dst[idx] + src[idx]);
+	}
+}
+
+template<typename T>
+static size_t compact_histogram_rank(const T* counts, size_t size, uint64_t rank)
+{
+	uint64_t accum = 0;
+	for (size_t idx = 0; idx < size; idx++) {
+		accum += counts[idx];
+		if (accum >= rank) {
+			return idx;
+		}
+	}
+	return size - 1;
+}
+
+xmr::utility::profiler::compact_histogram::~compact_histogram() {}
+
+xmr::utility::profiler::compact_histogram::compact_histogram(uint32_t precision)
+	: _precision(), _width(2), _counts16(), _counts32(), _counts64(), _total(0)
+{
+	if (precision < 1) {
+		precision = 1;
+	} else if (precision > 20) {
+		precision = 20;
+	}
+	_precision = precision;
+	_counts16.resize(histogram::size(_precision), 0);
+}
+
+void xmr::utility::profiler::compact_histogram::record_wide(size_t bucket, uint64_t count)
+{
+	uint64_t current = (_width == 2) ? _counts16[bucket] : _counts32[bucket];
+	uint64_t sum     = current + count;
+	widen(((sum > 0xFFFFFFFFull) || (sum < current)) ? 8 : 4);
+	if (_width == 4) {
+		_counts32[bucket] = static_cast<uint32_t>(sum);
+	} else {
+		_counts64[bucket] += count;
+	}
+}
+
+void xmr::utility::profiler::compact_histogram::widen(uint32_t width)
+{
+	if (width <= _width) {
+		return;
+	}
+
+	if (width == 4) {
+		_counts32.assign(_counts16.begin(), _counts16.end());
+	} else if (_width == 2) {
+		_counts64.assign(_counts16.begin(), _counts16.end());
+	} else {
+		_counts64.assign(_counts32.begin(), _counts32.end());
+	}
+
+	// Release the narrower arrays, shrink_to_fit is not guaranteed to.
+	std::vector<uint16_t>().swap(_counts16);
+	if (width == 8) {
+		std::vector<uint32_t>().swap(_counts32);
+	}
+	_width = width;
+}
+
+void xmr::utility::profiler::compact_histogram::add(const compact_histogram& other)
+{
+	if (other._precision != _precision) {
+		histogram resampled(_precision);
+		other.snapshot(resampled);
+		add(resampled);
+		return;
+	}
+
+	// Widen once up front if needed, so the loop itself has no overflow checks and vectorizes. No counter can exceed
+	// the total, so the counters only have to be scanned when the combined total does not fit.
+	size_t   size   = histogram::size(_precision);
+	uint32_t width  = std::max(_width, other._width);
+	uint64_t limit  = (width == 2) ? 0xFFFFull : 0xFFFFFFFFull;
+	uint64_t bound  = _total + other._total;
+	if ((width < 8) && ((bound < _total) || (bound > limit))) {
+		uint64_t largest = 0;
+		if (_width == 2) {
+			largest = compact_histogram_largest(_counts16.data(), size);
+		} else if (_width == 4) {
+			largest = compact_histogram_largest(_counts32.data(), size);
+		}
+		if (other._width == 2) {
+			largest += compact_histogram_largest(other._counts16.data(), size);
+		} else {
+			largest += compact_histogram_largest(other._counts32.data(), size);
+		}
+		if (largest > 0xFFFFFFFFull) {
+			width = 8;
+		} else if (largest > 0xFFFFull) {
+			width = std::max(width, 4u);
+		}
+	}
+	widen(width);
+
+	switch ((_width << 4) | other._width) {
+	case 0x22:
+		compact_histogram_add(_counts16.data(), other._counts16.data(), size);
+		break;
+	case 0x42:
+		compact_histogram_add(_counts32.data(), other._counts16.data(), size);
+		break;
+	case 0x44:
+		compact_histogram_add(_counts32.data(), other._counts32.data(), size);
+		break;
+	case 0x82:
+		compact_histogram_add(_counts64.data(), other._counts16.data(), size);
+		break;
+	case 0x84:
+		compact_histogram_add(_counts64.data(), other._counts32.data(), size);
+		break;
+	case 0x88:
+		compact_histogram_add(_counts64.data(), other._counts64.data(), size);
+		break;
+	}
+	_total += other._total;
+}
+
+void xmr::utility::profiler::compact_histogram::add(const histogram& other)
+{
+	if (other.precision() != _precision) {
+		histogram resampled(_precision);
+		other.resample(resampled);
+		add(resampled);
+		return;
+	}
+
+	const uint64_t* counts = other.counts();
+	for (size_t idx = 0; idx < other.size(); idx++) {
+		if (counts[idx] != 0) {
+			record(other.lowest(idx), counts[idx]);
+		}
+	}
+}
+
+void xmr::utility::profiler::compact_histogram::snapshot(histogram& target) const
+{
+	histogram  local(_precision);
+	histogram& output = (target.precision() == _precision) ? target : local;
+
+	size_t size = histogram::size(_precision);
+	for (size_t idx = 0; idx < size; idx++) {
+		uint64_t count = (_width == 2) ? _counts16[idx] : ((_width == 4) ? _counts32[idx] : _counts64[idx]);
+		if (count != 0) {
+			output.record(histogram::lowest(idx, _precision), count);
+		}
+	}
+
+	if (&output == &local) {
+		local.resample(target);
+	}
+}
+
+void xmr::utility::profiler::compact_histogram::clear()
+{
+	std::fill(_counts16.begin(), _counts16.end(), uint16_t(0));
+	std::fill(_counts32.begin(), _counts32.end(), uint32_t(0));
+	std::fill(_counts64.begin(), _counts64.end(), uint64_t(0));
+	_total = 0;
+}
+
+uint64_t xmr::utility::profiler::compact_histogram::percentile_events(double percentile) const
+{
+	if (_total == 0) {
+		return 0;
+	}
+
+	// Rank of the value, counting from 1.
+	double   rank_exact = std::ceil(percentile * static_cast<double>(_total));
+	uint64_t rank       = rank_exact < 1. ? 1 : static_cast<uint64_t>(rank_exact);
+	if (rank > _total) {
+		rank = _total;
+	}
+
+	size_t size = histogram::size(_precision);
+	size_t index;
+	switch (_width) {
+	case 2:
+		index = compact_histogram_rank(_counts16.data(), size, rank);
+		break;
+	case 4:
+		index = compact_histogram_rank(_counts32.data(), size, rank);
+		break;
+	default:
+		index = compact_histogram_rank(_counts64.data(), size, rank);
+		break;
+	}
+
+	return histogram::highest(index, _precision);
+}
@@ -0,0 +1,180 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/concurrency.hpp"
+
+#include <thread>
+
+// Threads are numbered once, and keep using the same shard in every tracker.
+static std::atomic<size_t> concurrency_threads(0);
+static thread_local size_t concurrency_thread = concurrency_threads.fetch_add(1, std::memory_order_relaxed);
+
+xmr::utility::profiler::concurrency::~concurrency() {}
+
+xmr::utility::profiler::concurrency::concurrency(size_t levels, size_t shards, uint32_t sample)
+	: _shards_count(), _shards(), _levels(levels > 0 ? levels : 1), _histogram(), _sample(sample > 0 ? sample : 1),
+	  _max(0), _origin(0), _started(0)
+{
+	if (shards == 0) {
+		shards = std::thread::hardware_concurrency();
+		if (shards == 0) {
+			shards = 1;
+		}
+	}
+	_shards_count = shards;
+
+	_shards.reset(new shard[_shards_count]);
+	for (size_t idx = 0; idx < _shards_count; idx++) {
+		_shards[idx].inflight.store(0, std::memory_order_relaxed);
+		_shards[idx].time.store(0, std::memory_order_relaxed);
+		_shards[idx].entries.store(0, std::memory_order_relaxed);
+	}
+
+	_histogram.reset(new std::atomic<uint64_t>[_shards_count * _levels]);
+	for (size_t idx = 0; idx < (_shards_count * _levels); idx++) {
+		_histogram[idx].store(0, std::memory_order_relaxed);
+	}
+}
+
+xmr::utility::profiler::concurrency::token xmr::utility::profiler::concurrency::enter(uint64_t now)
+{
+	token entry;
+	entry.shard = concurrency_thread % _shards_count;
+	entry.start = now;
+
+	// Any timestamp may be the first, so a separate state marks whether the origin has been set.
+	if (_started.load(std::memory_order_acquire) != 2) {
+		uint32_t expected = 0;
+		if (_started.compare_exchange_strong(expected, 1, std::memory_order_relaxed)) {
+			_origin.store(now, std::memory_order_relaxed);
+			_started.store(2, std::memory_order_release);
+		}
+	}
+
+	shard& local = _shards[entry.shard];
+	local.inflight.fetch_add(1, std::memory_order_relaxed);
+	if ((local.entries.fetch_add(1, std::memory_order_relaxed) % _sample) != 0) {
+		return entry;
+	}
+
+	// Sample the gauge, including this event. Shards may be updated while reading, so clamp to something sane.
+	int64_t level = 0;
+	for (size_t idx = 0; idx < _shards_count; idx++) {
+		level += _shards[idx].inflight.load(std::memory_order_relaxed);
+	}
+	if (level < 1) {
+		level = 1;
+	}
+
+	size_t bucket = static_cast<size_t>(level) - 1;
+	if (bucket >= _levels) {
+		bucket = _levels - 1;
+	}
+	_histogram[entry.shard * _levels + bucket].fetch_add(_sample, std::memory_order_relaxed);
+
+	uint64_t highest = _max.load(std::memory_order_relaxed);
+	while (static_cast<uint64_t>(level) > highest) {
+		if (_max.compare_exchange_weak(highest, static_cast<uint64_t>(level), std::memory_order_relaxed)) {
+			break;
+		}
+	}
+
+	return entry;
+}
+
+void xmr::utility::profiler::concurrency::leave(const token& entry, uint64_t now)
+{
+	shard& target = _shards[entry.shard];
+	target.time.fetch_add(now >= entry.start ? now - entry.start : 0, std::memory_order_relaxed);
+	target.inflight.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void xmr::utility::profiler::concurrency::clear()
+{
+	for (size_t idx = 0; idx < _shards_count; idx++) {
+		_shards[idx].time.store(0, std::memory_order_relaxed);
+	}
+	for (size_t idx = 0; idx < (_shards_count * _levels); idx++) {
+		_histogram[idx].store(0, std::memory_order_relaxed);
+	}
+	_max.store(0, std::memory_order_relaxed);
+	_started.store(0, std::memory_order_release);
+}
+
+uint64_t xmr::utility::profiler::concurrency::current()
+{
+	int64_t level = 0;
+	for (size_t idx = 0; idx < _shards_count; idx++) {
+		level += _shards[idx].inflight.load(std::memory_order_relaxed);
+	}
+	return level > 0 ? static_cast<uint64_t>(level) : 0;
+}
+
+uint64_t xmr::utility::profiler::concurrency::maximum()
+{
+	return _max.load(std::memory_order_relaxed);
+}
+
+double xmr::utility::profiler::concurrency::average(uint64_t now)
+{
+	if (_started.load(std::memory_order_acquire) != 2) {
+		return 0.;
+	}
+	uint64_t origin = _origin.load(std::memory_order_relaxed);
+	if (now <= origin) {
+		return 0.;
+	}
+
+	uint64_t time = 0;
+	for (size_t idx = 0; idx < _shards_count; idx++) {
+		time += _shards[idx].time.load(std::memory_order_relaxed);
+	}
+	return static_cast<double>(time) / static_cast<double>(now - origin);
+}
+
+void xmr::utility::profiler::concurrency::histogram(std::vector<uint64_t>& counts)
+{
+	counts.assign(_levels, 0);
+	for (size_t idx = 0; idx < _shards_count; idx++) {
+		for (size_t level = 0; level < _levels; level++) {
+			counts[level] += _histogram[idx * _levels + level].load(std::memory_order_relaxed);
+		}
+	}
+}
+
+uint64_t xmr::utility::profiler::concurrency::percentile(double percentile)
+{
+	std::vector<uint64_t> counts;
+	histogram(counts);
+
+	uint64_t total = 0;
+	for (auto count : counts) {
+		total += count;
+	}
+	if (total == 0) {
+		return 0;
+	}
+
+	// Find the first level whose cumulative count reaches the requested rank.
+	double   rank  = percentile * static_cast<double>(total);
+	uint64_t accum = 0;
+	for (size_t level = 0; level < counts.size(); level++) {
+		accum += counts[level];
+		if ((counts[level] != 0) && (static_cast<double>(accum) >= rank)) {
+			return level + 1;
+		}
+	}
+	return counts.size();
+}
@@ -0,0 +1,90 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/detector.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+xmr::utility::profiler::detector::~detector() {}
+
+xmr::utility::profiler::detector::detector(uint32_t zone, profiler& source, const callback_t& callback,
+										   double delta, double threshold, uint64_t warmup)
+	: _zone(zone), _profiler(source), _delta(delta), _threshold(threshold), _warmup(warmup), _callback(callback),
+	  _last_events(source.total_events()), _last_time(source.total_time())
+{
+	reset();
+}
+
+bool xmr::utility::profiler::detector::update(uint64_t now)
+{
+	uint64_t events = _profiler.total_events();
+	uint64_t time   = _profiler.total_time();
+	if ((events < _last_events) || (time < _last_time)) {
+		// The profiler was cleared, start over. Either total can be the only one to go backwards if the profiler was
+		// cleared and refilled between two updates.
+		_last_events = events;
+		_last_time   = time;
+		reset();
+		return false;
+	}
+
+	uint64_t interval_events = events - _last_events;
+	uint64_t interval_time   = time - _last_time;
+	_last_events             = events;
+	_last_time               = time;
+	if ((interval_events == 0) || (interval_time == 0)) {
+		return false;
+	}
+
+	double value = std::log(static_cast<double>(interval_time) / static_cast<double>(interval_events));
+
+	// Page-Hinkley, once for increases and once for decreases. The level is the mean of all intervals since the
+	// last change, and deviations smaller than delta are treated as noise.
+	double level = _mean;
+	_samples++;
+	_mean += (value - _mean) / static_cast<double>(_samples);
+	_up += value - _mean - _delta;
+	_up_min = std::min(_up_min, _up);
+	_down += _mean - value - _delta;
+	_down_min = std::min(_down_min, _down);
+
+	if (_samples <= _warmup) {
+		return false;
+	}
+	if (((_up - _up_min) <= _threshold) && ((_down - _down_min) <= _threshold)) {
+		return false;
+	}
+
+	event change;
+	change.zone      = _zone;
+	change.time      = now;
+	change.magnitude = std::exp(value - level);
+	reset();
+	if (_callback) {
+		_callback(change);
+	}
+	return true;
+}
+
+void xmr::utility::profiler::detector::reset()
+{
+	_samples  = 0;
+	_mean     = 0.;
+	_up       = 0.;
+	_up_min   = 0.;
+	_down     = 0.;
+	_down_min = 0.;
+}
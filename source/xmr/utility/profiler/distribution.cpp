@@ -0,0 +1,242 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/distribution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace xmr::utility::profiler;
+
+// Peaks below this fraction of the highest density are noise, not modes.
+static const double distribution_mode_floor = 0.05;
+
+// Two peaks are separate modes only if the density between them dips to at most this fraction of the lower one.
+static const double distribution_mode_valley = 0.5;
+
+static const size_t distribution_modes_max = 8;
+
+/** Range of values and how often they occurred, ascending and never overlapping.
+ */
+struct distribution_bin {
+	uint64_t lowest;
+	uint64_t highest;
+	uint64_t count;
+};
+
+static double distribution_center(const distribution_bin& bin)
+{
+	return (static_cast<double>(bin.lowest) + static_cast<double>(bin.highest)) / 2.;
+}
+
+static double distribution_density(const distribution_bin& bin)
+{
+	return static_cast<double>(bin.count) / (static_cast<double>(bin.highest - bin.lowest) + 1.);
+}
+
+/** Rank of a quantile, counting from 1, as ceil(count * numerator / denominator) without overflowing.
+ */
+static uint64_t distribution_rank(uint64_t count, uint64_t numerator, uint64_t denominator)
+{
+	uint64_t rank = (count / denominator) * numerator;
+	rank += ((count % denominator) * numerator + denominator - 1) / denominator;
+	return std::max<uint64_t>(rank, 1);
+}
+
+static void distribution_modes(const std::vector<distribution_bin>& groups, std::vector<double>& modes)
+{
+	// Only bins that touch are neighbours, anything between two bins that do not has a density of 0.
+	auto adjacent = [&groups](size_t left) { return (groups[left].highest + 1) == groups[left + 1].lowest; };
+
+	std::vector<size_t> peaks;
+	double              highest = 0.;
+	for (size_t idx = 0; idx < groups.size(); idx++) {
+		double density = distribution_density(groups[idx]);
+		double left    = ((idx > 0) && adjacent(idx - 1)) ? distribution_density(groups[idx - 1]) : 0.;
+		double right   = (((idx + 1) < groups.size()) && adjacent(idx)) ? distribution_density(groups[idx + 1]) : 0.;
+		if ((density > left) && (density >= right)) {
+			peaks.push_back(idx);
+			highest = std::max(highest, density);
+		}
+	}
+	std::stable_sort(peaks.begin(), peaks.end(), [&groups](size_t a, size_t b) {
+		return distribution_density(groups[a]) > distribution_density(groups[b]);
+	});
+
+	// Lowest density between two bins, both excluded.
+	auto valley = [&groups, &adjacent](size_t left, size_t right) {
+		double lowest = distribution_density(groups[left]);
+		for (size_t idx = left; idx < right; idx++) {
+			if (!adjacent(idx)) {
+				return 0.;
+			}
+			if ((idx + 1) < right) {
+				lowest = std::min(lowest, distribution_density(groups[idx + 1]));
+			}
+		}
+		return lowest;
+	};
+
+	// Accept peaks from the highest down, as long as they are separated from the nearest accepted peak on either side.
+	std::vector<size_t> accepted;
+	for (size_t peak : peaks) {
+		double density = distribution_density(groups[peak]);
+		if ((density < (highest * distribution_mode_floor)) || (accepted.size() >= distribution_modes_max)) {
+			break;
+		}
+
+		auto next     = std::lower_bound(accepted.begin(), accepted.end(), peak);
+		bool separate = true;
+		if (next != accepted.end()) {
+			separate &= valley(peak, *next) <= (density * distribution_mode_valley);
+		}
+		if (next != accepted.begin()) {
+			separate &= valley(*(next - 1), peak) <= (density * distribution_mode_valley);
+		}
+		if (separate) {
+			accepted.insert(next, peak);
+			modes.push_back(distribution_center(groups[peak]));
+		}
+	}
+}
+
+static void distribution_describe(const std::vector<distribution_bin>& values,
+								  const std::vector<distribution_bin>& groups, distribution& result)
+{
+	result = distribution();
+	if (values.empty()) {
+		return;
+	}
+
+	// Central moments, merging each bin as a block of identical values. Unlike raw power sums, this does not lose
+	// all precision to cancellation when the spread is small compared to the values.
+	double   n     = 0.;
+	double   mean  = 0.;
+	double   m2    = 0.;
+	double   m3    = 0.;
+	double   m4    = 0.;
+	uint64_t count = 0;
+	for (auto& bin : values) {
+		double k     = static_cast<double>(bin.count);
+		double total = n + k;
+		double delta = distribution_center(bin) - mean;
+		double ratio = delta / total;
+		m4 += ratio * ratio * (delta * delta * n * k * (n * n - n * k + k * k) / total + 6. * k * k * m2)
+			  - 4. * ratio * k * m3;
+		m3 += ratio * ratio * delta * n * k * (n - k) - 3. * ratio * k * m2;
+		m2 += delta * ratio * n * k;
+		mean += ratio * k;
+		n = total;
+		count += bin.count;
+	}
+
+	result.count     = count;
+	result.minimum   = values.front().lowest;
+	result.maximum   = values.back().highest;
+	result.mean      = mean;
+	result.variance  = m2 / n;
+	result.deviation = std::sqrt(result.variance);
+	if (m2 > 0.) {
+		result.skewness = std::sqrt(n) * m3 / std::pow(m2, 1.5);
+		result.kurtosis = n * m4 / (m2 * m2) - 3.;
+
+		// Sample-corrected skewness and kurtosis, as the coefficient is defined with them.
+		double g1 = result.skewness;
+		double g2 = result.kurtosis;
+		if (n > 3.) {
+			double adjust     = (n - 1.) / ((n - 2.) * (n - 3.));
+			double skewness   = g1 * std::sqrt(n * (n - 1.)) / (n - 2.);
+			double kurtosis   = adjust * ((n + 1.) * g2 + 6.);
+			result.bimodality = (skewness * skewness + 1.) / (kurtosis + 3. * (n - 1.) * adjust);
+		} else {
+			result.bimodality = (g1 * g1 + 1.) / (g2 + 3.);
+		}
+	}
+
+	// Quartiles in the same walk, by integer rank.
+	uint64_t ranks[3]   = {distribution_rank(count, 1, 4), distribution_rank(count, 1, 2),
+						   distribution_rank(count, 3, 4)};
+	double*  targets[3] = {&result.q1, &result.median, &result.q3};
+	size_t   middle     = 0;
+	uint64_t accum      = 0;
+	size_t   quartile   = 0;
+	for (size_t idx = 0; (idx < values.size()) && (quartile < 3); idx++) {
+		accum += values[idx].count;
+		while ((quartile < 3) && (accum >= ranks[quartile])) {
+			*targets[quartile] = distribution_center(values[idx]);
+			if (quartile == 1) {
+				middle = idx;
+			}
+			quartile++;
+		}
+	}
+	result.iqr = result.q3 - result.q1;
+
+	// Deviations grow in both directions from the median, so merging the two sides finds their median directly.
+	size_t   lower     = middle;     // Bins left below the median, the next one is lower - 1.
+	size_t   upper     = middle + 1; // Next bin above the median.
+	uint64_t taken     = values[middle].count;
+	double   deviation = 0.;
+	while ((taken < ranks[1]) && ((lower > 0) || (upper < values.size()))) {
+		double below = (lower > 0) ? (result.median - distribution_center(values[lower - 1])) : HUGE_VAL;
+		double above = (upper < values.size()) ? (distribution_center(values[upper]) - result.median) : HUGE_VAL;
+		if (below <= above) {
+			deviation = below;
+			taken += values[--lower].count;
+		} else {
+			deviation = above;
+			taken += values[upper++].count;
+		}
+	}
+	result.mad = deviation;
+
+	distribution_modes(groups, result.modes);
+}
+
+distribution xmr::utility::profiler::summary(const histogram& source)
+{
+	std::vector<distribution_bin> bins;
+	const uint64_t*               counts = source.counts();
+	for (size_t idx = 0; idx < source.size(); idx++) {
+		if (counts[idx] != 0) {
+			bins.push_back({source.lowest(idx), source.highest(idx), counts[idx]});
+		}
+	}
+
+	distribution result;
+	distribution_describe(bins, bins, result);
+	return result;
+}
+
+distribution xmr::utility::profiler::summary(xmr::utility::profiler::profiler& source, uint32_t precision)
+{
+	std::vector<distribution_bin> values;
+	std::vector<distribution_bin> groups;
+	source.visit([&values, &groups, precision](uint64_t time, uint64_t count) {
+		values.push_back({time, time, count});
+
+		// Timings arrive in ascending order, so each bucket is only ever extended at the back.
+		size_t bucket = histogram::index(time, precision);
+		if (!groups.empty() && (histogram::index(groups.back().lowest, precision) == bucket)) {
+			groups.back().count += count;
+		} else {
+			groups.push_back({histogram::lowest(bucket, precision), histogram::highest(bucket, precision), count});
+		}
+	});
+
+	distribution result;
+	distribution_describe(values, groups, result);
+	return result;
+}
@@ -0,0 +1,234 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/family.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include "xmr/utility/profiler/registry.hpp"
+
+static std::atomic<size_t> family_budget(10000);
+static std::atomic<size_t> family_used(0);
+
+static std::mutex& family_lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+static std::vector<xmr::utility::profiler::family*>& family_instances()
+{
+	static std::vector<xmr::utility::profiler::family*> instances;
+	return instances;
+}
+
+static std::string family_name(const char* name)
+{
+	// Metric names may only contain [a-zA-Z0-9_:] and must not start with a digit.
+	std::string result;
+	if ((*name >= '0') && (*name <= '9')) {
+		result.push_back('_');
+	}
+	for (; *name; name++) {
+		char c     = *name;
+		bool valid = ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9'))
+					 || (c == '_') || (c == ':');
+		result.push_back(valid ? c : '_');
+	}
+	return result;
+}
+
+static void family_write_label(std::FILE* file, const std::string& label)
+{
+	// "quantile" is set by the summary itself, and names starting with "__" are reserved for Prometheus. Rename them
+	// the same way Prometheus renames conflicting target labels.
+	std::string name = family_name(label.c_str());
+	if ((name == "quantile") || (name.compare(0, 2, "__") == 0)) {
+		std::fputs("exported_", file);
+	}
+	std::fputs(name.c_str(), file);
+}
+
+static void family_write_labels(std::FILE* file, const std::vector<std::string>& labels,
+								const std::vector<std::string>& values, const char* quantile)
+{
+	std::fputc('{', file);
+	for (size_t idx = 0; idx < labels.size(); idx++) {
+		if (idx != 0) {
+			std::fputc(',', file);
+		}
+		family_write_label(file, labels[idx]);
+		std::fputs("=\"", file);
+		for (char c : values[idx]) {
+			switch (c) {
+			case '\\':
+				std::fputs("\\\\", file);
+				break;
+			case '"':
+				std::fputs("\\\"", file);
+				break;
+			case '\n':
+				std::fputs("\\n", file);
+				break;
+			default:
+				std::fputc(c, file);
+			}
+		}
+		std::fputc('"', file);
+	}
+	if (quantile) {
+		std::fprintf(file, "%squantile=\"%s\"", labels.empty() ? "" : ",", quantile);
+	}
+	std::fputc('}', file);
+}
+
+xmr::utility::profiler::family::~family()
+{
+	{
+		std::lock_guard<std::mutex> l(family_lock());
+		auto&                       instances = family_instances();
+		instances.erase(std::remove(instances.begin(), instances.end(), this), instances.end());
+	}
+
+	// Give the combinations back to the shared budget.
+	family_used.fetch_sub(_entries.size(), std::memory_order_relaxed);
+}
+
+xmr::utility::profiler::family::family(uint32_t zone, const std::vector<std::string>& labels)
+	: _zone(zone), _labels(labels), _overflow(), _overflowed(0), _lock(), _entries(), _order()
+{
+	_overflow.values.assign(_labels.size(), "(overflow)");
+
+	std::lock_guard<std::mutex> l(family_lock());
+	family_instances().push_back(this);
+}
+
+xmr::utility::profiler::profiler& xmr::utility::profiler::family::get(std::initializer_list<const char*> values)
+{
+	std::vector<std::string> strings;
+	strings.reserve(values.size());
+	for (const char* value : values) {
+		strings.emplace_back(value ? value : "");
+	}
+	return get(strings);
+}
+
+xmr::utility::profiler::profiler& xmr::utility::profiler::family::get(const std::vector<std::string>& values)
+{
+	// Prefix every value with its length, so that no combination of values can produce the key of another.
+	std::string key;
+	for (size_t idx = 0; idx < _labels.size(); idx++) {
+		const std::string& value = (idx < values.size()) ? values[idx] : std::string();
+		key.append(std::to_string(value.size()));
+		key.push_back(':');
+		key.append(value);
+	}
+
+	std::lock_guard<std::mutex> l(_lock);
+	auto                        itr = _entries.find(key);
+	if (itr != _entries.end()) {
+		return itr->second->timings;
+	}
+
+	if (family_used.fetch_add(1, std::memory_order_relaxed) >= family_budget.load(std::memory_order_relaxed)) {
+		family_used.fetch_sub(1, std::memory_order_relaxed);
+		_overflowed.fetch_add(1, std::memory_order_relaxed);
+		return _overflow.timings;
+	}
+
+	std::unique_ptr<entry> fresh(new entry());
+	fresh->values = values;
+	fresh->values.resize(_labels.size());
+	_order.push_back(fresh.get());
+	return _entries.emplace(std::move(key), std::move(fresh)).first->second->timings;
+}
+
+void xmr::utility::profiler::family::collect(std::vector<series>& entries)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	entries.clear();
+	entries.reserve(_order.size() + 1);
+	for (entry* item : _order) {
+		entries.push_back({item->values, &item->timings, false});
+	}
+	if (_overflowed.load(std::memory_order_relaxed) != 0) {
+		entries.push_back({_overflow.values, &_overflow.timings, true});
+	}
+}
+
+void xmr::utility::profiler::family::budget(size_t combinations)
+{
+	family_budget.store(combinations, std::memory_order_relaxed);
+}
+
+size_t xmr::utility::profiler::family::used()
+{
+	return family_used.load(std::memory_order_relaxed);
+}
+
+bool xmr::utility::profiler::family::write_prometheus(std::FILE* file)
+{
+	static const std::pair<const char*, double> quantiles[] = {{"0.5", 0.5}, {"0.9", 0.9}, {"0.99", 0.99}};
+
+	std::lock_guard<std::mutex> l(family_lock());
+
+	// Families of the same zone, or of zones that only differ in characters the format does not allow, share one
+	// metric, which may only have one TYPE line.
+	std::vector<std::pair<std::string, std::vector<family*>>> metrics;
+	for (family* instance : family_instances()) {
+		const char* zone = registry::name(instance->_zone);
+		std::string name = family_name(zone ? zone : "unknown");
+		size_t      idx  = 0;
+		while ((idx < metrics.size()) && (metrics[idx].first != name)) {
+			idx++;
+		}
+		if (idx == metrics.size()) {
+			metrics.emplace_back(name, std::vector<family*>());
+		}
+		metrics[idx].second.push_back(instance);
+	}
+
+	std::vector<series> entries;
+	for (auto& metric : metrics) {
+		const char* name = metric.first.c_str();
+		std::fprintf(file, "# TYPE %s summary\n", name);
+
+		uint64_t overflowed = 0;
+		for (family* instance : metric.second) {
+			instance->collect(entries);
+			for (auto& item : entries) {
+				for (auto& quantile : quantiles) {
+					std::fputs(name, file);
+					family_write_labels(file, instance->_labels, item.values, quantile.first);
+					std::fprintf(file, " %" PRIu64 "\n", item.timings->percentile_events(quantile.second));
+				}
+
+				std::fprintf(file, "%s_sum", name);
+				family_write_labels(file, instance->_labels, item.values, nullptr);
+				std::fprintf(file, " %" PRIu64 "\n", item.timings->total_time());
+
+				std::fprintf(file, "%s_count", name);
+				family_write_labels(file, instance->_labels, item.values, nullptr);
+				std::fprintf(file, " %" PRIu64 "\n", item.timings->total_events());
+			}
+			overflowed += instance->overflowed();
+		}
+
+		std::fprintf(file, "# TYPE %s_overflowed_total counter\n", name);
+		std::fprintf(file, "%s_overflowed_total %" PRIu64 "\n", name, overflowed);
+	}
+
+	return std::ferror(file) == 0;
+}
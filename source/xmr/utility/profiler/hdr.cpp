@@ -0,0 +1,760 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/hdr.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace xmr::utility::profiler;
+
+static const uint32_t hdr_cookie            = 0x1c849313; // V2 encoding, with the word size nibble set.
+static const uint32_t hdr_cookie_compressed = 0x1c849314; // V2 compressed encoding.
+static const uint32_t hdr_cookie_mask       = ~0xF0u;     // Readers ignore the word size nibble.
+static const size_t   hdr_header_size       = 40;
+
+// Precision of the histogram layout for 0 to 5 significant digits, which is log2 of the HdrHistogram sub-bucket count.
+static const uint32_t hdr_precisions[] = {1, 5, 8, 11, 15, 18};
+
+// Largest payload any layout can need, a header and a count of at most 9 bytes for every bucket.
+static const size_t hdr_payload_limit = hdr_header_size + 9 * histogram::size(18);
+
+// Big-endian and ZigZag LEB128 helpers
+
+static void hdr_put32(std::vector<uint8_t>& out, size_t offset, uint32_t value)
+{
+	out[offset + 0] = static_cast<uint8_t>(value >> 24);
+	out[offset + 1] = static_cast<uint8_t>(value >> 16);
+	out[offset + 2] = static_cast<uint8_t>(value >> 8);
+	out[offset + 3] = static_cast<uint8_t>(value);
+}
+
+static void hdr_put64(std::vector<uint8_t>& out, size_t offset, uint64_t value)
+{
+	hdr_put32(out, offset, static_cast<uint32_t>(value >> 32));
+	hdr_put32(out, offset + 4, static_cast<uint32_t>(value));
+}
+
+static uint32_t hdr_get32(const uint8_t* in)
+{
+	return (uint32_t(in[0]) << 24) | (uint32_t(in[1]) << 16) | (uint32_t(in[2]) << 8) | uint32_t(in[3]);
+}
+
+static uint64_t hdr_get64(const uint8_t* in)
+{
+	return (uint64_t(hdr_get32(in)) << 32) | hdr_get32(in + 4);
+}
+
+static void hdr_put_varint(std::vector<uint8_t>& out, int64_t signed_value)
+{
+	// HdrHistogram uses at most 9 bytes, the last one holding a full 8 bits instead of 7.
+	uint64_t value = (static_cast<uint64_t>(signed_value) << 1) ^ static_cast<uint64_t>(signed_value >> 63);
+	for (size_t idx = 0; idx < 8; idx++) {
+		if ((value >> 7) == 0) {
+			out.push_back(static_cast<uint8_t>(value));
+			return;
+		}
+		out.push_back(static_cast<uint8_t>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool hdr_get_varint(const uint8_t*& in, const uint8_t* end, int64_t& signed_value)
+{
+	uint64_t value = 0;
+	for (size_t idx = 0; idx < 9; idx++) {
+		if (in == end) {
+			return false;
+		}
+		uint8_t byte = *(in++);
+		if (idx == 8) {
+			value |= uint64_t(byte) << 56;
+			break;
+		}
+		value |= uint64_t(byte & 0x7F) << (idx * 7);
+		if ((byte & 0x80) == 0) {
+			break;
+		}
+	}
+	signed_value = static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	return true;
+}
+
+// Deflate, only as much as needed: compression with fixed Huffman codes, decompression of everything.
+
+static const uint16_t hdr_length_base[29]  = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+											  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t  hdr_length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+											  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t hdr_distance_base[30]  = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+												33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+												1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t  hdr_distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+												6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+struct hdr_bit_writer {
+	std::vector<uint8_t>& out;
+	uint64_t              bits;
+	uint32_t              count;
+
+	void put(uint32_t value, uint32_t length)
+	{
+		bits |= uint64_t(value) << count;
+		count += length;
+		while (count >= 8) {
+			out.push_back(static_cast<uint8_t>(bits));
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	void put_code(uint32_t code, uint32_t length)
+	{
+		// Huffman codes are stored starting with their most significant bit.
+		uint32_t reversed = 0;
+		for (uint32_t idx = 0; idx < length; idx++) {
+			reversed = (reversed << 1) | ((code >> idx) & 1);
+		}
+		put(reversed, length);
+	}
+
+	void put_literal(uint32_t symbol)
+	{
+		if (symbol < 144) {
+			put_code(0x30 + symbol, 8);
+		} else if (symbol < 256) {
+			put_code(0x190 + symbol - 144, 9);
+		} else if (symbol < 280) {
+			put_code(symbol - 256, 7);
+		} else {
+			put_code(0xC0 + symbol - 280, 8);
+		}
+	}
+
+	void put_match(uint32_t length, uint32_t distance)
+	{
+		uint32_t code = 28;
+		while (hdr_length_base[code] > length) {
+			code--;
+		}
+		put_literal(257 + code);
+		put(length - hdr_length_base[code], hdr_length_extra[code]);
+
+		code = 29;
+		while (hdr_distance_base[code] > distance) {
+			code--;
+		}
+		put_code(code, 5);
+		put(distance - hdr_distance_base[code], hdr_distance_extra[code]);
+	}
+
+	void flush()
+	{
+		if (count > 0) {
+			out.push_back(static_cast<uint8_t>(bits));
+		}
+		bits  = 0;
+		count = 0;
+	}
+};
+
+static uint32_t hdr_adler32(const uint8_t* data, size_t size)
+{
+	uint32_t a = 1, b = 0;
+	while (size > 0) {
+		// 5552 is the largest block after which b can not overflow 32 bits.
+		size_t block = size < 5552 ? size : 5552;
+		size -= block;
+		for (; block > 0; block--) {
+			a += *(data++);
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+static void hdr_deflate(const uint8_t* in, size_t size, std::vector<uint8_t>& out, std::vector<int32_t>& matches)
+{
+	// zlib header for a 32KiB window, without a preset dictionary.
+	out.push_back(0x78);
+	out.push_back(0x01);
+
+	// A single hash table entry per 3-byte sequence and greedy matching. The encoded counts consist mostly of short
+	// repeating byte patterns, which this already compresses well.
+	matches.assign(4096, -1);
+	hdr_bit_writer writer = {out, 0, 0};
+	writer.put(1, 1); // Final block.
+	writer.put(1, 2); // Fixed Huffman codes.
+
+	size_t position = 0;
+	while (position < size) {
+		uint32_t length   = 0;
+		uint32_t distance = 0;
+		if (position + 3 <= size) {
+			uint32_t hash = ((uint32_t(in[position]) << 16) | (uint32_t(in[position + 1]) << 8) | in[position + 2]);
+			hash          = (hash * 2654435761u) >> 20;
+			int32_t match = matches[hash];
+			matches[hash] = static_cast<int32_t>(position);
+			if ((match >= 0) && ((position - static_cast<size_t>(match)) <= 32768)) {
+				size_t limit = size - position;
+				limit        = limit < 258 ? limit : 258;
+				while ((length < limit) && (in[static_cast<size_t>(match) + length] == in[position + length])) {
+					length++;
+				}
+				distance = static_cast<uint32_t>(position - static_cast<size_t>(match));
+			}
+		}
+
+		if (length >= 3) {
+			writer.put_match(length, distance);
+			position += length;
+		} else {
+			writer.put_literal(in[position]);
+			position++;
+		}
+	}
+	writer.put_literal(256);
+	writer.flush();
+
+	uint32_t adler = hdr_adler32(in, size);
+	out.push_back(static_cast<uint8_t>(adler >> 24));
+	out.push_back(static_cast<uint8_t>(adler >> 16));
+	out.push_back(static_cast<uint8_t>(adler >> 8));
+	out.push_back(static_cast<uint8_t>(adler));
+}
+
+struct hdr_bit_reader {
+	const uint8_t* in;
+	const uint8_t* end;
+	uint32_t       bits;
+	uint32_t       count;
+	bool           failed;
+
+	uint32_t get(uint32_t length)
+	{
+		while (count < length) {
+			if (in == end) {
+				failed = true;
+				return 0;
+			}
+			bits |= uint32_t(*(in++)) << count;
+			count += 8;
+		}
+		uint32_t value = bits & ((uint32_t(1) << length) - 1);
+		bits >>= length;
+		count -= length;
+		return value;
+	}
+};
+
+struct hdr_huffman {
+	uint16_t counts[16];   // Number of codes of each length.
+	uint16_t symbols[288]; // Symbols ordered by code.
+
+	bool build(const uint8_t* lengths, size_t size)
+	{
+		uint16_t offsets[16];
+		std::memset(counts, 0, sizeof(counts));
+		for (size_t idx = 0; idx < size; idx++) {
+			counts[lengths[idx]]++;
+		}
+		counts[0] = 0;
+
+		offsets[1] = 0;
+		for (size_t idx = 1; idx < 15; idx++) {
+			offsets[idx + 1] = offsets[idx] + counts[idx];
+		}
+		for (size_t idx = 0; idx < size; idx++) {
+			if (lengths[idx] != 0) {
+				symbols[offsets[lengths[idx]]++] = static_cast<uint16_t>(idx);
+			}
+		}
+		return true;
+	}
+
+	int32_t decode(hdr_bit_reader& reader) const
+	{
+		// Canonical codes of one length are consecutive, so walk the lengths until the code falls into a range.
+		int32_t code = 0, first = 0, index = 0;
+		for (size_t length = 1; length < 16; length++) {
+			code |= static_cast<int32_t>(reader.get(1));
+			if (reader.failed) {
+				return -1;
+			}
+			int32_t count = counts[length];
+			if ((code - first) < count) {
+				return symbols[index + code - first];
+			}
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+		return -1;
+	}
+};
+
+/** Check that the inflated payload stays within its limit.
+ *
+ * Once the header is out, the limit tightens to the payload length it declares, so a small input can not inflate to
+ * far more than it claims.
+ */
+static bool hdr_inflate_check(const std::vector<uint8_t>& out, size_t& limit)
+{
+	if (out.size() >= 8) {
+		limit = std::min(limit, hdr_header_size + hdr_get32(out.data() + 4));
+	}
+	return out.size() <= limit;
+}
+
+static bool hdr_inflate_block(hdr_bit_reader& reader, const hdr_huffman& literals, const hdr_huffman& distances,
+							  std::vector<uint8_t>& out, size_t& limit)
+{
+	while (true) {
+		if (!hdr_inflate_check(out, limit)) {
+			return false;
+		}
+
+		int32_t symbol = literals.decode(reader);
+		if (symbol < 0) {
+			return false;
+		} else if (symbol < 256) {
+			out.push_back(static_cast<uint8_t>(symbol));
+		} else if (symbol == 256) {
+			return true;
+		} else {
+			symbol -= 257;
+			if (symbol >= 29) {
+				return false;
+			}
+			uint32_t length = hdr_length_base[symbol] + reader.get(hdr_length_extra[symbol]);
+
+			int32_t code = distances.decode(reader);
+			if ((code < 0) || (code >= 30)) {
+				return false;
+			}
+			uint32_t distance = hdr_distance_base[code] + reader.get(hdr_distance_extra[code]);
+			if (reader.failed || (distance > out.size())) {
+				return false;
+			}
+
+			// Byte by byte, as the source may overlap the output.
+			size_t source = out.size() - distance;
+			for (uint32_t idx = 0; idx < length; idx++) {
+				out.push_back(out[source + idx]);
+			}
+		}
+	}
+}
+
+static bool hdr_inflate(const uint8_t* in, size_t size, std::vector<uint8_t>& out, size_t limit)
+{
+	if ((size < 6) || ((in[0] & 0x0F) != 8) || ((((uint32_t(in[0]) << 8) | in[1]) % 31) != 0) || (in[1] & 0x20)) {
+		return false;
+	}
+
+	hdr_bit_reader reader = {in + 2, in + size, 0, 0, false};
+	hdr_huffman    literals, distances;
+	uint32_t       final_block;
+	do {
+		final_block   = reader.get(1);
+		uint32_t type = reader.get(2);
+		if (type == 0) {
+			// Stored, starts at the next byte.
+			reader.bits  = 0;
+			reader.count = 0;
+			if ((reader.end - reader.in) < 4) {
+				return false;
+			}
+			uint32_t length = uint32_t(reader.in[0]) | (uint32_t(reader.in[1]) << 8);
+			uint32_t check  = uint32_t(reader.in[2]) | (uint32_t(reader.in[3]) << 8);
+			reader.in += 4;
+			if (((length ^ 0xFFFF) != check) || (static_cast<size_t>(reader.end - reader.in) < length)
+				|| !hdr_inflate_check(out, limit) || ((limit - out.size()) < length)) {
+				return false;
+			}
+			out.insert(out.end(), reader.in, reader.in + length);
+			reader.in += length;
+		} else if (type == 1) {
+			uint8_t lengths[288];
+			std::memset(lengths, 8, 144);
+			std::memset(lengths + 144, 9, 112);
+			std::memset(lengths + 256, 7, 24);
+			std::memset(lengths + 280, 8, 8);
+			literals.build(lengths, 288);
+			std::memset(lengths, 5, 30);
+			distances.build(lengths, 30);
+			if (!hdr_inflate_block(reader, literals, distances, out, limit)) {
+				return false;
+			}
+		} else if (type == 2) {
+			static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+			uint32_t literal_count  = reader.get(5) + 257;
+			uint32_t distance_count = reader.get(5) + 1;
+			uint32_t code_count     = reader.get(4) + 4;
+
+			uint8_t lengths[288 + 32] = {0};
+			for (uint32_t idx = 0; idx < code_count; idx++) {
+				lengths[order[idx]] = static_cast<uint8_t>(reader.get(3));
+			}
+			hdr_huffman codes;
+			codes.build(lengths, 19);
+
+			std::memset(lengths, 0, 19);
+			uint32_t total = literal_count + distance_count;
+			for (uint32_t idx = 0; idx < total;) {
+				int32_t symbol = codes.decode(reader);
+				if (symbol < 0) {
+					return false;
+				} else if (symbol < 16) {
+					lengths[idx++] = static_cast<uint8_t>(symbol);
+					continue;
+				}
+
+				uint8_t  value  = 0;
+				uint32_t repeat = 0;
+				if (symbol == 16) {
+					if (idx == 0) {
+						return false;
+					}
+					value  = lengths[idx - 1];
+					repeat = 3 + reader.get(2);
+				} else if (symbol == 17) {
+					repeat = 3 + reader.get(3);
+				} else {
+					repeat = 11 + reader.get(7);
+				}
+				if ((idx + repeat) > total) {
+					return false;
+				}
+				for (; repeat > 0; repeat--) {
+					lengths[idx++] = value;
+				}
+			}
+			if ((literal_count > 286) || (distance_count > 30) || reader.failed) {
+				return false;
+			}
+
+			literals.build(lengths, literal_count);
+			distances.build(lengths + literal_count, distance_count);
+			if (!hdr_inflate_block(reader, literals, distances, out, limit)) {
+				return false;
+			}
+		} else {
+			return false;
+		}
+		if (reader.failed) {
+			return false;
+		}
+	} while (!final_block);
+	if (!hdr_inflate_check(out, limit)) {
+		return false;
+	}
+
+	// The Adler-32 checksum follows at the next byte boundary.
+	if ((reader.end - reader.in) < 4) {
+		return false;
+	}
+	return hdr_get32(reader.in) == hdr_adler32(out.data(), out.size());
+}
+
+// Base64
+
+static const char hdr_base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int32_t hdr_base64_value(char c)
+{
+	if ((c >= 'A') && (c <= 'Z')) {
+		return c - 'A';
+	} else if ((c >= 'a') && (c <= 'z')) {
+		return c - 'a' + 26;
+	} else if ((c >= '0') && (c <= '9')) {
+		return c - '0' + 52;
+	} else if (c == '+') {
+		return 62;
+	} else if (c == '/') {
+		return 63;
+	}
+	return -1;
+}
+
+
+xmr::utility::profiler::hdr::encoder::~encoder() {}
+
+xmr::utility::profiler::hdr::encoder::encoder() : _payload(), _output(), _matches(), _text(), _resample() {}
+
+const std::vector<uint8_t>& xmr::utility::profiler::hdr::encoder::encode(const histogram& source)
+{
+	// Find the layout HdrHistogram can represent, and resample into it if needed.
+	uint32_t digits = 5;
+	for (uint32_t idx = 0; idx < 6; idx++) {
+		if (hdr_precisions[idx] >= source.precision()) {
+			digits = idx;
+			break;
+		}
+	}
+	const histogram* input = &source;
+	if (hdr_precisions[digits] != source.precision()) {
+		if (!_resample || (_resample->precision() != hdr_precisions[digits])) {
+			_resample.reset(new histogram(hdr_precisions[digits]));
+		}
+		_resample->clear();
+		source.resample(*_resample);
+		input = _resample.get();
+	}
+
+	// HdrHistogram only tracks values up to 2^63 - 1.
+	const uint64_t* counts = input->counts();
+	size_t          size   = input->size();
+	size_t          last   = 0;
+	for (size_t idx = 0; idx < size; idx++) {
+		if (counts[idx] != 0) {
+			last = idx + 1;
+		}
+	}
+	uint64_t highest = last > 0 ? input->highest(last - 1) : 2;
+	if (highest > 0x7FFFFFFFFFFFFFFFull) {
+		highest = 0x7FFFFFFFFFFFFFFFull;
+	} else if (highest < 2) {
+		highest = 2;
+	}
+
+	_payload.resize(hdr_header_size);
+	int64_t zeros = 0;
+	for (size_t idx = 0; idx < last; idx++) {
+		int64_t count = static_cast<int64_t>(counts[idx] & 0x7FFFFFFFFFFFFFFFull);
+		if (count == 0) {
+			zeros++;
+			continue;
+		}
+		if (zeros > 0) {
+			// A negative count is a run of empty buckets.
+			hdr_put_varint(_payload, zeros > 1 ? -zeros : 0);
+			zeros = 0;
+		}
+		hdr_put_varint(_payload, count);
+	}
+
+	hdr_put32(_payload, 0, hdr_cookie);
+	hdr_put32(_payload, 4, static_cast<uint32_t>(_payload.size() - hdr_header_size));
+	hdr_put32(_payload, 8, 0);       // Normalizing index offset.
+	hdr_put32(_payload, 12, digits); // Significant value digits.
+	hdr_put64(_payload, 16, 1);      // Lowest discernible value.
+	hdr_put64(_payload, 24, highest);
+	hdr_put64(_payload, 32, 0x3FF0000000000000ull); // Integer to double conversion ratio of 1.0.
+
+	_output.resize(8);
+	hdr_deflate(_payload.data(), _payload.size(), _output, _matches);
+	hdr_put32(_output, 0, hdr_cookie_compressed);
+	hdr_put32(_output, 4, static_cast<uint32_t>(_output.size() - 8));
+	return _output;
+}
+
+const std::string& xmr::utility::profiler::hdr::encoder::encode_base64(const histogram& source)
+{
+	const std::vector<uint8_t>& data = encode(source);
+
+	_text.clear();
+	for (size_t idx = 0; idx < data.size(); idx += 3) {
+		uint32_t remaining = static_cast<uint32_t>(data.size() - idx);
+		uint32_t block     = uint32_t(data[idx]) << 16;
+		if (remaining > 1) {
+			block |= uint32_t(data[idx + 1]) << 8;
+		}
+		if (remaining > 2) {
+			block |= data[idx + 2];
+		}
+		_text.push_back(hdr_base64[(block >> 18) & 0x3F]);
+		_text.push_back(hdr_base64[(block >> 12) & 0x3F]);
+		_text.push_back(remaining > 1 ? hdr_base64[(block >> 6) & 0x3F] : '=');
+		_text.push_back(remaining > 2 ? hdr_base64[block & 0x3F] : '=');
+	}
+	return _text;
+}
+
+static bool hdr_decode_payload(const uint8_t* data, size_t size, histogram& target)
+{
+	if (size < hdr_header_size) {
+		return false;
+	}
+
+	uint32_t length = hdr_get32(data + 4);
+	uint32_t offset = hdr_get32(data + 8);
+	uint32_t digits = hdr_get32(data + 12);
+	uint64_t lowest = hdr_get64(data + 16);
+	if ((digits > 5) || (offset != 0) || (lowest == 0) || ((size - hdr_header_size) < length)) {
+		return false;
+	}
+
+	// A lowest discernible value above 1 scales every bucket by a power of two.
+	uint32_t shift = 0;
+	while ((lowest >> (shift + 1)) != 0) {
+		shift++;
+	}
+
+	uint32_t  precision = hdr_precisions[digits];
+	histogram decoded(precision);
+	size_t    index = 0;
+	const uint8_t* in  = data + hdr_header_size;
+	const uint8_t* end = in + length;
+	while (in < end) {
+		int64_t count;
+		if (!hdr_get_varint(in, end, count)) {
+			return false;
+		}
+		if (count < 0) {
+			index += static_cast<size_t>(-count);
+			continue;
+		}
+		if (index >= decoded.size()) {
+			return false;
+		}
+		if (count > 0) {
+			decoded.record(histogram::lowest(index, precision) << shift, static_cast<uint64_t>(count));
+		}
+		index++;
+	}
+
+	target.add(decoded);
+	return true;
+}
+
+bool xmr::utility::profiler::hdr::decode(const uint8_t* data, size_t size, histogram& target)
+{
+	if (size < 8) {
+		return false;
+	}
+
+	uint32_t cookie = hdr_get32(data) & hdr_cookie_mask;
+	if (cookie == (hdr_cookie & hdr_cookie_mask)) {
+		return hdr_decode_payload(data, size, target);
+	} else if (cookie != (hdr_cookie_compressed & hdr_cookie_mask)) {
+		return false;
+	}
+
+	uint32_t length = hdr_get32(data + 4);
+	if ((size - 8) < length) {
+		return false;
+	}
+
+	std::vector<uint8_t> payload;
+	if (!hdr_inflate(data + 8, length, payload, hdr_payload_limit) || (payload.size() < 4)
+		|| ((hdr_get32(payload.data()) & hdr_cookie_mask) != (hdr_cookie & hdr_cookie_mask))) {
+		return false;
+	}
+	return hdr_decode_payload(payload.data(), payload.size(), target);
+}
+
+bool xmr::utility::profiler::hdr::decode_base64(const char* text, size_t length, histogram& target)
+{
+	std::vector<uint8_t> data;
+	data.reserve(length / 4 * 3);
+
+	uint32_t block = 0;
+	uint32_t count = 0;
+	for (size_t idx = 0; idx < length; idx++) {
+		char c = text[idx];
+		if ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n')) {
+			continue;
+		} else if (c == '=') {
+			break;
+		}
+
+		int32_t value = hdr_base64_value(c);
+		if (value < 0) {
+			return false;
+		}
+		block = (block << 6) | static_cast<uint32_t>(value);
+		if (++count == 4) {
+			data.push_back(static_cast<uint8_t>(block >> 16));
+			data.push_back(static_cast<uint8_t>(block >> 8));
+			data.push_back(static_cast<uint8_t>(block));
+			block = 0;
+			count = 0;
+		}
+	}
+	if (count == 2) {
+		data.push_back(static_cast<uint8_t>(block >> 4));
+	} else if (count == 3) {
+		data.push_back(static_cast<uint8_t>(block >> 10));
+		data.push_back(static_cast<uint8_t>(block >> 2));
+	} else if (count == 1) {
+		return false;
+	}
+
+	return decode(data.data(), data.size(), target);
+}
+
+size_t xmr::utility::profiler::hdr::read_log(std::FILE* file, histogram& target, size_t* skipped)
+{
+	size_t      intervals = 0;
+	size_t      failures  = 0;
+	std::string line;
+	char        buffer[4096];
+
+	bool more = true;
+	while (more) {
+		// Read a whole line, intervals of large histograms easily exceed the buffer.
+		line.clear();
+		while (true) {
+			if (!std::fgets(buffer, sizeof(buffer), file)) {
+				more = false;
+				break;
+			}
+			line.append(buffer);
+			if (!line.empty() && (line.back() == '\n')) {
+				break;
+			}
+		}
+		while (!line.empty() && ((line.back() == '\n') || (line.back() == '\r'))) {
+			line.pop_back();
+		}
+		if (line.empty() || (line[0] == '#') || (line[0] == '"')) {
+			continue;
+		}
+
+		// [Tag=<tag>,]<start>,<length>,<max>,<histogram>
+		size_t start = 0;
+		if (line.compare(0, 4, "Tag=") == 0) {
+			start = line.find(',');
+			if (start == std::string::npos) {
+				failures++;
+				continue;
+			}
+			start++;
+		}
+		size_t comma = start;
+		for (size_t field = 0; (field < 3) && (comma != std::string::npos); field++) {
+			comma = line.find(',', comma);
+			if (comma != std::string::npos) {
+				comma++;
+			}
+		}
+		if ((comma == std::string::npos)
+			|| !decode_base64(line.data() + comma, line.size() - comma, target)) {
+			failures++;
+			continue;
+		}
+		intervals++;
+	}
+
+	if (skipped) {
+		*skipped = failures;
+	}
+	return intervals;
+}
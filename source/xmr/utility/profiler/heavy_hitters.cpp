@@ -0,0 +1,253 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/heavy_hitters.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// Threads are numbered once, and keep using the same shard in every tracker.
+static std::atomic<size_t> heavy_hitters_threads(0);
+static thread_local size_t heavy_hitters_thread = heavy_hitters_threads.fetch_add(1, std::memory_order_relaxed);
+
+static size_t heavy_hitters_slot(uint64_t key, size_t mask)
+{
+	// Keys are often sequential ids, so mix them before using the low bits.
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDull;
+	key ^= key >> 33;
+	return static_cast<size_t>(key) & mask;
+}
+
+xmr::utility::profiler::heavy_hitters::summary::summary(size_t capacity)
+	: _heap(), _index(), _capacity(capacity > 0 ? capacity : 1)
+{
+	_heap.reserve(_capacity);
+	_index.reserve(_capacity);
+}
+
+void xmr::utility::profiler::heavy_hitters::summary::add(uint64_t key, uint64_t weight)
+{
+	auto itr = _index.find(key);
+	if (itr != _index.end()) {
+		_heap[itr->second].value += weight;
+		sift(itr->second);
+		return;
+	}
+
+	if (_heap.size() < _capacity) {
+		// Not full yet, so the value is exact. Move the new entry up until its parent is not larger.
+		_heap.push_back({key, weight, 0});
+		size_t position = _heap.size() - 1;
+		while (position > 0) {
+			size_t parent = (position - 1) / 2;
+			if (_heap[parent].value <= _heap[position].value) {
+				break;
+			}
+			std::swap(_heap[parent], _heap[position]);
+			_index[_heap[position].key] = position;
+			position                    = parent;
+		}
+		_index[key] = position;
+		return;
+	}
+
+	// Replace the key with the lowest value, which bounds how often the new key could have been seen before.
+	entry& lowest = _heap.front();
+	_index.erase(lowest.key);
+	lowest.error = lowest.value;
+	lowest.value += weight;
+	lowest.key = key;
+	_index[key] = 0;
+	sift(0);
+}
+
+void xmr::utility::profiler::heavy_hitters::summary::sift(size_t position)
+{
+	// Values only ever grow, so entries only ever move towards the leaves.
+	while (true) {
+		size_t left     = position * 2 + 1;
+		size_t right    = left + 1;
+		size_t smallest = position;
+		if ((left < _heap.size()) && (_heap[left].value < _heap[smallest].value)) {
+			smallest = left;
+		}
+		if ((right < _heap.size()) && (_heap[right].value < _heap[smallest].value)) {
+			smallest = right;
+		}
+		if (smallest == position) {
+			break;
+		}
+		std::swap(_heap[position], _heap[smallest]);
+		_index[_heap[position].key] = position;
+		_index[_heap[smallest].key] = smallest;
+		position                    = smallest;
+	}
+}
+
+void xmr::utility::profiler::heavy_hitters::summary::get(std::vector<entry>& entries, size_t count)
+{
+	entries = _heap;
+	std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) { return a.value > b.value; });
+	if ((count != 0) && (entries.size() > count)) {
+		entries.resize(count);
+	}
+}
+
+void xmr::utility::profiler::heavy_hitters::summary::clear()
+{
+	_heap.clear();
+	_index.clear();
+}
+
+xmr::utility::profiler::heavy_hitters::~heavy_hitters() {}
+
+xmr::utility::profiler::heavy_hitters::heavy_hitters(size_t capacity, xmr::utility::profiler::profiler* timings,
+													 size_t slots, size_t shards)
+	: _timings(timings), _slots(1), _shards_count(), _shards(), _lock(), _by_count(capacity), _by_time(capacity),
+	  _total_count(0), _total_time(0)
+{
+	while (_slots < slots) {
+		_slots <<= 1;
+	}
+
+	if (shards == 0) {
+		shards = std::thread::hardware_concurrency();
+		if (shards == 0) {
+			shards = 1;
+		}
+	}
+	_shards_count = shards;
+
+	_shards.reset(new shard[_shards_count]);
+	for (size_t idx = 0; idx < _shards_count; idx++) {
+		_shards[idx].slots.reset(new slot[_slots]());
+		_shards[idx].used = 0;
+	}
+}
+
+uint64_t xmr::utility::profiler::heavy_hitters::track(uint64_t key, uint64_t time_end, uint64_t time_start)
+{
+	uint64_t difference;
+	if (_timings) {
+		difference = _timings->track(time_end, time_start);
+	} else {
+		difference = elapsed(time_end, time_start);
+	}
+
+	record(key, difference);
+	return difference;
+}
+
+void xmr::utility::profiler::heavy_hitters::record(uint64_t key, uint64_t duration)
+{
+	shard&                      local = _shards[heavy_hitters_thread % _shards_count];
+	std::lock_guard<std::mutex> l(local.lock);
+
+	size_t mask = _slots - 1;
+	for (size_t position = heavy_hitters_slot(key, mask);; position = (position + 1) & mask) {
+		slot& item = local.slots[position];
+		if (item.count == 0) {
+			item.key   = key;
+			item.count = 1;
+			item.time  = duration;
+			local.used++;
+			break;
+		} else if (item.key == key) {
+			item.count++;
+			item.time += duration;
+			break;
+		}
+	}
+
+	// Merge at half occupancy, which keeps probe sequences short.
+	if (local.used >= (_slots / 2)) {
+		flush(local);
+	}
+}
+
+void xmr::utility::profiler::heavy_hitters::merge()
+{
+	for (size_t idx = 0; idx < _shards_count; idx++) {
+		shard&                      local = _shards[idx];
+		std::lock_guard<std::mutex> l(local.lock);
+		if (local.used != 0) {
+			flush(local);
+		}
+	}
+}
+
+void xmr::utility::profiler::heavy_hitters::flush(shard& local)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	for (size_t position = 0; position < _slots; position++) {
+		slot& item = local.slots[position];
+		if (item.count != 0) {
+			_by_count.add(item.key, item.count);
+			_by_time.add(item.key, item.time);
+			_total_count += item.count;
+			_total_time += item.time;
+			item.count = 0;
+		}
+	}
+	local.used = 0;
+}
+
+void xmr::utility::profiler::heavy_hitters::clear()
+{
+	for (size_t idx = 0; idx < _shards_count; idx++) {
+		shard&                      local = _shards[idx];
+		std::lock_guard<std::mutex> l(local.lock);
+		for (size_t position = 0; position < _slots; position++) {
+			local.slots[position].count = 0;
+		}
+		local.used = 0;
+	}
+
+	std::lock_guard<std::mutex> gl(_lock);
+	_by_count.clear();
+	_by_time.clear();
+	_total_count = 0;
+	_total_time  = 0;
+}
+
+void xmr::utility::profiler::heavy_hitters::top_by_count(std::vector<entry>& entries, size_t count)
+{
+	merge();
+	std::lock_guard<std::mutex> l(_lock);
+	_by_count.get(entries, count);
+}
+
+void xmr::utility::profiler::heavy_hitters::top_by_time(std::vector<entry>& entries, size_t count)
+{
+	merge();
+	std::lock_guard<std::mutex> l(_lock);
+	_by_time.get(entries, count);
+}
+
+uint64_t xmr::utility::profiler::heavy_hitters::total_events()
+{
+	merge();
+	std::lock_guard<std::mutex> l(_lock);
+	return _total_count;
+}
+
+uint64_t xmr::utility::profiler::heavy_hitters::total_time()
+{
+	merge();
+	std::lock_guard<std::mutex> l(_lock);
+	return _total_time;
+}
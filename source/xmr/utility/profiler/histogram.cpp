@@ -0,0 +1,202 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+xmr::utility::profiler::histogram::~histogram() {}
+
+xmr::utility::profiler::histogram::histogram(uint32_t precision) : _precision(), _counts(), _total(0)
+{
+	if (precision < 1) {
+		precision = 1;
+	} else if (precision > 20) {
+		precision = 20;
+	}
+	_precision = precision;
+
+	_counts.resize(size(precision), 0);
+}
+
+void xmr::utility::profiler::histogram::add(const histogram& other)
+{
+	if (other._precision != _precision) {
+		histogram resampled(_precision);
+		other.resample(resampled);
+		add(resampled);
+		return;
+	}
+
+	uint64_t*       dst  = _counts.data();
+	const uint64_t* src  = other._counts.data();
+	size_t          size = _counts.size();
+	for (size_t idx = 0; idx < size; idx++) {
+		dst[idx] += src[idx];
+	}
+	_total += other._total;
+}
+
+void xmr::utility::profiler::histogram::add(xmr::utility::profiler::profiler& other)
+{
+	std::map<uint64_t, uint64_t> timings;
+	other.timings(timings);
+	for (auto& kv : timings) {
+		record(kv.first, kv.second);
+	}
+}
+
+void xmr::utility::profiler::histogram::subtract(const histogram& other)
+{
+	if (other._precision != _precision) {
+		histogram resampled(_precision);
+		other.resample(resampled);
+		subtract(resampled);
+		return;
+	}
+
+	// Written without branches, so the loop still vectorizes.
+	uint64_t*       dst   = _counts.data();
+	const uint64_t* src   = other._counts.data();
+	size_t          size  = _counts.size();
+	uint64_t        total = 0;
+	for (size_t idx = 0; idx < size; idx++) {
+		uint64_t value = dst[idx] - (src[idx] < dst[idx] ? src[idx] : dst[idx]);
+		dst[idx]       = value;
+		total += value;
+	}
+	_total = total;
+}
+
+void xmr::utility::profiler::histogram::scale(double factor)
+{
+	if (!(factor > 0.)) {
+		clear();
+		return;
+	}
+
+	uint64_t* dst   = _counts.data();
+	size_t    size  = _counts.size();
+	uint64_t  total = 0;
+	for (size_t idx = 0; idx < size; idx++) {
+		uint64_t value = static_cast<uint64_t>(static_cast<double>(dst[idx]) * factor + 0.5);
+		dst[idx]       = value;
+		total += value;
+	}
+	_total = total;
+}
+
+void xmr::utility::profiler::histogram::resample(histogram& target) const
+{
+	for (size_t idx = 0; idx < _counts.size(); idx++) {
+		uint64_t count = _counts[idx];
+		if (count == 0) {
+			continue;
+		}
+
+		uint64_t low   = lowest(idx);
+		uint64_t high  = highest(idx);
+		size_t   first = target.index(low);
+		size_t   last  = target.index(high);
+		if (first == last) {
+			target._counts[first] += count;
+			target._total += count;
+			continue;
+		}
+
+		// Split by overlap, and give whatever rounding left over to the last bucket.
+		double   width     = static_cast<double>(high - low) + 1.;
+		uint64_t remaining = count;
+		for (size_t tidx = first; tidx < last; tidx++) {
+			uint64_t overlap_low  = target.lowest(tidx) > low ? target.lowest(tidx) : low;
+			uint64_t overlap_high = target.highest(tidx) < high ? target.highest(tidx) : high;
+			double   overlap      = static_cast<double>(overlap_high - overlap_low) + 1.;
+			uint64_t share        = static_cast<uint64_t>(static_cast<double>(count) * overlap / width);
+			if (share > remaining) {
+				share = remaining;
+			}
+			target._counts[tidx] += share;
+			remaining -= share;
+		}
+		target._counts[last] += remaining;
+		target._total += count;
+	}
+}
+
+void xmr::utility::profiler::histogram::clear()
+{
+	std::fill(_counts.begin(), _counts.end(), uint64_t(0));
+	_total = 0;
+}
+
+uint64_t xmr::utility::profiler::histogram::lowest(size_t index, uint32_t precision)
+{
+	uint32_t half_shift = precision - 1;
+	if (index < (size_t(2) << half_shift)) {
+		return index;
+	}
+
+	uint32_t exponent = static_cast<uint32_t>(index >> half_shift) - 2;
+	uint64_t mantissa = index - (static_cast<size_t>(exponent + 1) << half_shift);
+	return mantissa << (exponent + 1);
+}
+
+uint64_t xmr::utility::profiler::histogram::highest(size_t index, uint32_t precision)
+{
+	uint32_t half_shift = precision - 1;
+	if (index < (size_t(2) << half_shift)) {
+		return index;
+	}
+
+	uint32_t exponent = static_cast<uint32_t>(index >> half_shift) - 2;
+	return lowest(index, precision) + ((uint64_t(1) << (exponent + 1)) - 1);
+}
+
+double xmr::utility::profiler::histogram::total_time() const
+{
+	double time = 0.;
+	for (size_t idx = 0; idx < _counts.size(); idx++) {
+		if (_counts[idx] != 0) {
+			double middle = (static_cast<double>(lowest(idx)) + static_cast<double>(highest(idx))) / 2.;
+			time += middle * static_cast<double>(_counts[idx]);
+		}
+	}
+	return time;
+}
+
+uint64_t xmr::utility::profiler::histogram::percentile_events(double percentile) const
+{
+	if (_total == 0) {
+		return 0;
+	}
+
+	// Rank of the value, counting from 1.
+	double   rank_exact = std::ceil(percentile * static_cast<double>(_total));
+	uint64_t rank       = rank_exact < 1. ? 1 : static_cast<uint64_t>(rank_exact);
+	if (rank > _total) {
+		rank = _total;
+	}
+
+	uint64_t accum = 0;
+	for (size_t idx = 0; idx < _counts.size(); idx++) {
+		accum += _counts[idx];
+		if (accum >= rank) {
+			return highest(idx);
+		}
+	}
+	return highest(_counts.size() - 1);
+}
@@ -0,0 +1,432 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/instrument.hpp"
+#include "xmr/utility/profiler/clock/hpc.hpp"
+#include "xmr/utility/profiler/symbolizer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+
+// Nothing in here may be instrumented, or the hooks would recurse into themselves.
+#define INSTRUMENT_HOOK __attribute__((no_instrument_function))
+
+using namespace xmr::utility::profiler;
+
+static const size_t instrument_stack_depth = 256;
+
+/** Timings of one function on one thread.
+ *
+ * The address is published with release semantics after the exclusion has been decided, and only the owning thread
+ * updates the counters. collect() may therefore read them at any time, at worst missing the latest call.
+ */
+struct instrument_slot {
+	std::atomic<uintptr_t> address;
+	std::atomic<bool>      excluded;
+	std::atomic<uint64_t>  calls;
+	std::atomic<uint64_t>  total;
+	std::atomic<uint64_t>  histogram[instrument::buckets];
+};
+
+struct instrument_frame {
+	void*            address;
+	instrument_slot* slot;  // Only valid if the call is sampled.
+	uint64_t         start; // 0 if the call is not sampled.
+};
+
+/** State of one thread.
+ *
+ * The table uses open addressing with linear probing and never grows, so lookups stay lock-free for collect().
+ */
+struct instrument_thread {
+	std::unique_ptr<instrument_slot[]> slots;
+	size_t                             mask;
+	size_t                             used;
+	std::atomic<uint64_t>              dropped;
+	instrument_frame                   stack[instrument_stack_depth];
+	size_t                             depth;
+	uint32_t                           countdown;
+};
+
+static std::atomic<size_t>   instrument_capacity(4096);
+static std::atomic<uint32_t> instrument_every(1);
+static std::atomic<bool>     instrument_enabled(true);
+static std::atomic<bool>     instrument_excluding(false);
+
+// Threads are never removed, so their timings can still be collected after they exit.
+static std::mutex& instrument_lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+static std::vector<std::unique_ptr<instrument_thread>>& instrument_threads()
+{
+	static std::vector<std::unique_ptr<instrument_thread>> threads;
+	return threads;
+}
+
+static std::vector<std::string>& instrument_exclusions()
+{
+	static std::vector<std::string> exclusions;
+	return exclusions;
+}
+
+static thread_local instrument_thread* instrument_local = nullptr;
+static thread_local bool               instrument_busy  = false;
+
+INSTRUMENT_HOOK static std::string instrument_demangle(const char* name)
+{
+	int   status    = 0;
+	char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+	if ((status != 0) || (demangled == nullptr)) {
+		return name;
+	}
+	std::string result = demangled;
+	std::free(demangled);
+	return result;
+}
+
+INSTRUMENT_HOOK static bool instrument_is_excluded(const std::vector<std::string>& exclusions,
+												   const instrument::function& entry)
+{
+	// The name comes from the symbolizer, which also knows static functions. dladdr only knows exported ones, but
+	// has the mangled name.
+	Dl_info info;
+	if ((dladdr(entry.address, &info) == 0) || (info.dli_saddr != entry.address)) {
+		info.dli_sname = nullptr;
+	}
+
+	for (auto& prefix : exclusions) {
+		if ((!entry.name.empty() && (entry.name.compare(0, prefix.size(), prefix) == 0))
+			|| (info.dli_sname && (std::strncmp(info.dli_sname, prefix.c_str(), prefix.size()) == 0))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Decide whether a function that a thread sees for the first time is excluded.
+ *
+ * Runs once per function and thread, so the symbolizer lookup stays off the path of every later call.
+ */
+INSTRUMENT_HOOK static bool instrument_is_excluded(void* address)
+{
+	if (!instrument_excluding.load(std::memory_order_acquire)) {
+		return false;
+	}
+
+	instrument::function entry;
+	entry.address = address;
+	symbolizer::instance().resolve(address, entry.name);
+
+	std::lock_guard<std::mutex> l(instrument_lock());
+	return instrument_is_excluded(instrument_exclusions(), entry);
+}
+
+INSTRUMENT_HOOK static instrument_thread* instrument_acquire()
+{
+	if (instrument_local) {
+		return instrument_local;
+	}
+
+	size_t capacity = 16;
+	while (capacity < instrument_capacity.load(std::memory_order_relaxed)) {
+		capacity <<= 1;
+	}
+
+	std::unique_ptr<instrument_thread> state(new instrument_thread());
+	state->slots.reset(new instrument_slot[capacity]());
+	state->mask      = capacity - 1;
+	state->used      = 0;
+	state->depth     = 0;
+	state->countdown = 1;
+	state->dropped.store(0, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> l(instrument_lock());
+	instrument_local = state.get();
+	instrument_threads().push_back(std::move(state));
+	return instrument_local;
+}
+
+INSTRUMENT_HOOK static instrument_slot* instrument_find(instrument_thread* state, void* address)
+{
+	uintptr_t key  = reinterpret_cast<uintptr_t>(address);
+	size_t    hash = static_cast<size_t>((static_cast<uint64_t>(key >> 4) * 0x9E3779B97F4A7C15ull) >> 32);
+	for (size_t probe = 0; probe <= state->mask; probe++) {
+		instrument_slot& slot    = state->slots[(hash + probe) & state->mask];
+		uintptr_t        current = slot.address.load(std::memory_order_relaxed);
+		if (current == key) {
+			return &slot;
+		} else if (current != 0) {
+			continue;
+		}
+
+		// Keep the load factor at or below 3/4, so probe sequences stay short.
+		if ((state->used + 1) * 4 > (state->mask + 1) * 3) {
+			return nullptr;
+		}
+		state->used++;
+		slot.excluded.store(instrument_is_excluded(address), std::memory_order_relaxed);
+		slot.address.store(key, std::memory_order_release);
+		return &slot;
+	}
+	return nullptr;
+}
+
+extern "C" INSTRUMENT_HOOK void __cyg_profile_func_enter(void* this_fn, void* call_site)
+{
+	(void)call_site;
+	if (instrument_busy) {
+		return;
+	}
+	instrument_busy = true;
+
+	instrument_thread* state = instrument_acquire();
+	if (state->depth < instrument_stack_depth) {
+		instrument_frame& frame = state->stack[state->depth];
+		frame.address           = this_fn;
+		frame.slot              = nullptr;
+		frame.start             = 0;
+		if (instrument_enabled.load(std::memory_order_relaxed) && (--state->countdown == 0)) {
+			state->countdown = instrument_every.load(std::memory_order_relaxed);
+
+			// Deciding the exclusion of a new function can take a while, so shift the start of the enclosing frames
+			// by that time to keep it out of their timings.
+			bool     excluding = instrument_excluding.load(std::memory_order_relaxed);
+			uint64_t before    = excluding ? clock::hpc::now() : 0;
+			frame.slot         = instrument_find(state, this_fn);
+			if (excluding) {
+				uint64_t spent = clock::hpc::now() - before;
+				for (size_t idx = 0; idx < state->depth; idx++) {
+					if (state->stack[idx].start != 0) {
+						state->stack[idx].start += spent;
+					}
+				}
+			}
+
+			if (frame.slot == nullptr) {
+				state->dropped.fetch_add(1, std::memory_order_relaxed);
+			} else if (!frame.slot->excluded.load(std::memory_order_relaxed)) {
+				frame.start = clock::hpc::now();
+			}
+		}
+	} else {
+		state->dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+	state->depth++;
+
+	instrument_busy = false;
+}
+
+extern "C" INSTRUMENT_HOOK void __cyg_profile_func_exit(void* this_fn, void* call_site)
+{
+	(void)call_site;
+	if (instrument_busy || (instrument_local == nullptr)) {
+		return;
+	}
+	uint64_t now = clock::hpc::now();
+	instrument_busy = true;
+
+	instrument_thread* state = instrument_local;
+	if (state->depth > instrument_stack_depth) {
+		state->depth--;
+	} else if (state->depth > 0) {
+		// Frames may have been skipped by longjmp, so unwind to the matching function if the top does not match.
+		size_t depth = state->depth;
+		while ((depth > 0) && (state->stack[depth - 1].address != this_fn)) {
+			depth--;
+		}
+		if (depth > 0) {
+			state->depth                  = depth - 1;
+			const instrument_frame& frame = state->stack[depth - 1];
+			if (frame.start != 0) {
+				instrument_slot* slot     = frame.slot;
+				uint64_t         duration = now >= frame.start ? now - frame.start : 0;
+				size_t           bucket   = duration > 1 ? static_cast<size_t>(63 - __builtin_clzll(duration)) : 0;
+				if (bucket >= instrument::buckets) {
+					bucket = instrument::buckets - 1;
+				}
+				slot->calls.store(slot->calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				slot->total.store(slot->total.load(std::memory_order_relaxed) + duration, std::memory_order_relaxed);
+				slot->histogram[bucket].store(slot->histogram[bucket].load(std::memory_order_relaxed) + 1,
+											  std::memory_order_relaxed);
+			}
+		}
+	}
+
+	instrument_busy = false;
+}
+
+void xmr::utility::profiler::instrument::capacity(size_t functions)
+{
+	instrument_capacity.store(functions, std::memory_order_relaxed);
+}
+
+void xmr::utility::profiler::instrument::sample(uint32_t every)
+{
+	instrument_every.store(every > 0 ? every : 1, std::memory_order_relaxed);
+}
+
+void xmr::utility::profiler::instrument::exclude(const char* prefix)
+{
+	std::lock_guard<std::mutex> l(instrument_lock());
+	instrument_exclusions().emplace_back(prefix);
+	instrument_excluding.store(true, std::memory_order_release);
+}
+
+void xmr::utility::profiler::instrument::enable(bool enabled)
+{
+	instrument_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t xmr::utility::profiler::instrument::dropped()
+{
+	uint64_t                    total = 0;
+	std::lock_guard<std::mutex> l(instrument_lock());
+	for (auto& state : instrument_threads()) {
+		total += state->dropped.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+void xmr::utility::profiler::instrument::collect(std::vector<function>& functions)
+{
+	// Keep the hooks quiet while holding the lock, in case this file was built with -finstrument-functions too.
+	bool busy       = instrument_busy;
+	instrument_busy = true;
+
+	std::map<uintptr_t, function> merged;
+	std::vector<std::string>      exclusions;
+	{
+		std::lock_guard<std::mutex> l(instrument_lock());
+		exclusions = instrument_exclusions();
+		for (auto& state : instrument_threads()) {
+			for (size_t idx = 0; idx <= state->mask; idx++) {
+				instrument_slot& slot    = state->slots[idx];
+				uintptr_t        address = slot.address.load(std::memory_order_acquire);
+				if ((address == 0) || slot.excluded.load(std::memory_order_relaxed)) {
+					continue;
+				}
+
+				auto entry = merged.find(address);
+				if (entry == merged.end()) {
+					function empty;
+					empty.address = reinterpret_cast<void*>(address);
+					empty.calls   = 0;
+					empty.total   = 0;
+					std::fill(empty.histogram, empty.histogram + buckets, 0);
+					entry = merged.emplace(address, empty).first;
+				}
+
+				function& target = entry->second;
+				target.calls += slot.calls.load(std::memory_order_relaxed);
+				target.total += slot.total.load(std::memory_order_relaxed);
+				for (size_t bucket = 0; bucket < buckets; bucket++) {
+					target.histogram[bucket] += slot.histogram[bucket].load(std::memory_order_relaxed);
+				}
+			}
+		}
+	}
+
+	functions.clear();
+	functions.reserve(merged.size());
+	for (auto& kv : merged) {
+		if (kv.second.calls != 0) {
+			functions.push_back(std::move(kv.second));
+		}
+	}
+
+	// Symbolize only now, in one batch, instead of on the recording path.
+	std::vector<const void*> addresses(functions.size());
+	std::vector<std::string> names;
+	for (size_t idx = 0; idx < functions.size(); idx++) {
+		addresses[idx] = functions[idx].address;
+	}
+	symbolizer& symbols = symbolizer::instance();
+	symbols.refresh();
+	symbols.resolve(addresses, names);
+	for (size_t idx = 0; idx < functions.size(); idx++) {
+		functions[idx].name = std::move(names[idx]);
+		if (functions[idx].name.empty()) {
+			Dl_info info;
+			if ((dladdr(functions[idx].address, &info) != 0) && (info.dli_sname != nullptr)) {
+				functions[idx].name = instrument_demangle(info.dli_sname);
+			}
+		}
+	}
+
+	// Functions seen before their prefix was excluded were still timed.
+	if (!exclusions.empty()) {
+		functions.erase(std::remove_if(functions.begin(), functions.end(),
+									   [&exclusions](const function& entry) {
+										   return instrument_is_excluded(exclusions, entry);
+									   }),
+						functions.end());
+	}
+	std::sort(functions.begin(), functions.end(),
+			  [](const function& a, const function& b) { return a.total > b.total; });
+
+	instrument_busy = busy;
+}
+
+bool xmr::utility::profiler::instrument::write_report(std::FILE* file, size_t limit)
+{
+	std::vector<function> functions;
+	collect(functions);
+
+	bool busy       = instrument_busy;
+	instrument_busy = true;
+
+	std::fprintf(file, "%12s %14s %12s %12s %12s  %s\n", "Calls", "Total(ns)", "Average(ns)", "p50(ns)", "p99(ns)",
+				 "Function");
+	for (size_t idx = 0; idx < functions.size(); idx++) {
+		if ((limit != 0) && (idx >= limit)) {
+			break;
+		}
+		const function& entry = functions[idx];
+
+		// Percentiles are the upper bound of the bucket they fall into.
+		uint64_t p50 = 0, p99 = 0, accum = 0;
+		for (size_t bucket = 0; bucket < buckets; bucket++) {
+			accum += entry.histogram[bucket];
+			if ((p50 == 0) && (accum * 100 >= entry.calls * 50)) {
+				p50 = 2ull << bucket;
+			}
+			if ((p99 == 0) && (accum * 100 >= entry.calls * 99)) {
+				p99 = 2ull << bucket;
+			}
+		}
+
+		std::fprintf(file, "%12" PRIu64 " %14" PRIu64 " %12.1f %12" PRIu64 " %12" PRIu64 "  ", entry.calls,
+					 entry.total, static_cast<double>(entry.total) / static_cast<double>(entry.calls), p50, p99);
+		if (entry.name.empty()) {
+			std::fprintf(file, "%p\n", entry.address);
+		} else {
+			std::fprintf(file, "%s\n", entry.name.c_str());
+		}
+	}
+
+	instrument_busy = busy;
+	return std::ferror(file) == 0;
+}
@@ -0,0 +1,537 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/json_exporter.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "xmr/utility/profiler/registry.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace xmr::utility::profiler;
+
+static const size_t json_exporter_buffer_size = 65536;
+
+static const struct {
+	const char* name;
+	uint64_t resources::sample::*field;
+} json_exporter_resources[] = {
+	{"time", &resources::sample::time},
+	{"resident", &resources::sample::resident},
+	{"resident_peak", &resources::sample::resident_peak},
+	{"swapped", &resources::sample::swapped},
+	{"virtual_size", &resources::sample::virtual_size},
+	{"user_time", &resources::sample::user_time},
+	{"system_time", &resources::sample::system_time},
+	{"minor_faults", &resources::sample::minor_faults},
+	{"major_faults", &resources::sample::major_faults},
+	{"voluntary_switches", &resources::sample::voluntary_switches},
+	{"involuntary_switches", &resources::sample::involuntary_switches},
+	{"block_reads", &resources::sample::block_reads},
+	{"block_writes", &resources::sample::block_writes},
+	{"threads", &resources::sample::threads},
+};
+
+static const char json_exporter_digits[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+										   "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+										   "8081828384858687888990919293949596979899";
+
+struct json_exporter_fd {
+	int fd;
+
+	bool put(const char* data, size_t size)
+	{
+		while (size > 0) {
+#ifdef _WIN32
+			int written = _write(fd, data, static_cast<unsigned int>(size));
+#else
+			ssize_t written = ::write(fd, data, size);
+#endif
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			data += written;
+			size -= static_cast<size_t>(written);
+		}
+		return true;
+	}
+};
+
+struct json_exporter_string {
+	std::string& output;
+
+	bool put(const char* data, size_t size)
+	{
+		output.append(data, size);
+		return true;
+	}
+};
+
+/** Buffered writer of JSON tokens.
+ *
+ * Everything is first written into a fixed buffer, which is handed to the sink whenever it could overflow. Tokens
+ * are never longer than a few dozen bytes except for strings, which are written in pieces.
+ */
+template<typename Sink>
+struct json_exporter_stream {
+	Sink&  sink;
+	char*  buffer;
+	size_t used;
+	bool   failed;
+
+	void flush()
+	{
+		if (used > 0) {
+			failed |= !sink.put(buffer, used);
+			used = 0;
+		}
+	}
+
+	char* reserve(size_t size)
+	{
+		if ((used + size) > json_exporter_buffer_size) {
+			flush();
+		}
+		return buffer + used;
+	}
+
+	void raw(const char* data, size_t size)
+	{
+		while (size > 0) {
+			size_t chunk = std::min(size, json_exporter_buffer_size / 2);
+			std::memcpy(reserve(chunk), data, chunk);
+			used += chunk;
+			data += chunk;
+			size -= chunk;
+		}
+	}
+
+	template<size_t N>
+	void literal(const char (&text)[N])
+	{
+		raw(text, N - 1);
+	}
+
+	void integer(uint64_t value)
+	{
+		// Two digits at a time, from the back.
+		char  digits[20];
+		char* end   = digits + sizeof(digits);
+		char* start = end;
+		while (value >= 100) {
+			size_t pair = static_cast<size_t>(value % 100) * 2;
+			value /= 100;
+			*(--start) = json_exporter_digits[pair + 1];
+			*(--start) = json_exporter_digits[pair];
+		}
+		if (value >= 10) {
+			size_t pair = static_cast<size_t>(value) * 2;
+			*(--start)  = json_exporter_digits[pair + 1];
+			*(--start)  = json_exporter_digits[pair];
+		} else {
+			*(--start) = static_cast<char>('0' + value);
+		}
+		raw(start, static_cast<size_t>(end - start));
+	}
+
+	void number(double value)
+	{
+		if (!std::isfinite(value)) {
+			literal("null");
+			return;
+		}
+		if (value < 0.) {
+			literal("-");
+			value = -value;
+		}
+
+		// Fixed point with six decimals covers everything measured here. Anything outside of that falls back to
+		// printf, which is slower but exact.
+		if (value >= 1e13) {
+			char text[32];
+			int  length = std::snprintf(text, sizeof(text), "%.17g", value);
+			raw(text, static_cast<size_t>(length));
+			return;
+		}
+
+		uint64_t scaled   = static_cast<uint64_t>(value * 1e6 + 0.5);
+		uint64_t whole    = scaled / 1000000;
+		uint64_t fraction = scaled % 1000000;
+		integer(whole);
+		if (fraction != 0) {
+			char   digits[7] = {'.', '0', '0', '0', '0', '0', '0'};
+			size_t length    = 7;
+			for (size_t idx = 6; idx > 0; idx--) {
+				digits[idx] = static_cast<char>('0' + (fraction % 10));
+				fraction /= 10;
+			}
+			while (digits[length - 1] == '0') {
+				length--;
+			}
+			raw(digits, length);
+		}
+	}
+
+	void string(const char* text)
+	{
+		static const char hex[] = "0123456789abcdef";
+
+		literal("\"");
+		const char* run = text;
+		for (; *text; text++) {
+			unsigned char c = static_cast<unsigned char>(*text);
+			if ((c >= 0x20) && (c != '"') && (c != '\\')) {
+				continue;
+			}
+
+			raw(run, static_cast<size_t>(text - run));
+			run = text + 1;
+			if (c == '"') {
+				literal("\\\"");
+			} else if (c == '\\') {
+				literal("\\\\");
+			} else if (c == '\n') {
+				literal("\\n");
+			} else {
+				char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+				raw(escape, sizeof(escape));
+			}
+		}
+		raw(run, static_cast<size_t>(text - run));
+		literal("\"");
+	}
+};
+
+/** Write the statistics of a zone, leaving the object open for further members.
+ */
+template<typename Sink>
+static void json_exporter_zone(json_exporter_stream<Sink>& out, uint32_t zone, uint64_t count, double sum,
+							   uint64_t minimum, uint64_t maximum, const std::vector<double>& quantiles,
+							   const uint64_t* values)
+{
+	const char* name = registry::name(zone);
+	out.literal("{\"zone\":");
+	out.string(name ? name : "unknown");
+	out.literal(",\"id\":");
+	out.integer(zone);
+	out.literal(",\"count\":");
+	out.integer(count);
+	out.literal(",\"sum\":");
+	out.number(sum);
+	if (count > 0) {
+		out.literal(",\"min\":");
+		out.integer(minimum);
+		out.literal(",\"max\":");
+		out.integer(maximum);
+		out.literal(",\"mean\":");
+		out.number(sum / static_cast<double>(count));
+	}
+
+	out.literal(",\"quantiles\":{");
+	for (size_t quantile = 0; quantile < quantiles.size(); quantile++) {
+		if (quantile != 0) {
+			out.literal(",");
+		}
+		out.literal("\"");
+		out.number(quantiles[quantile]);
+		out.literal("\":");
+		if (count > 0) {
+			out.integer(values[quantile]);
+		} else {
+			out.literal("null");
+		}
+	}
+	out.literal("}");
+}
+
+xmr::utility::profiler::json_exporter::~json_exporter() {}
+
+xmr::utility::profiler::json_exporter::json_exporter(const std::vector<double>& quantiles, bool buckets)
+	: _lock(), _sources(), _rates(), _quantiles(quantiles), _buckets(buckets), _scratch(), _values(), _objectives(),
+	  _resources(), _costs(), _buffer(json_exporter_buffer_size)
+{
+	std::sort(_quantiles.begin(), _quantiles.end());
+}
+
+void xmr::utility::profiler::json_exporter::add(uint32_t zone, xmr::utility::profiler::profiler& timings)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	_sources.push_back({zone, &timings, nullptr});
+}
+
+void xmr::utility::profiler::json_exporter::add(uint32_t zone, histogram& buckets)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	_sources.push_back({zone, nullptr, &buckets});
+}
+
+void xmr::utility::profiler::json_exporter::remove(xmr::utility::profiler::profiler& timings)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	_sources.erase(std::remove_if(_sources.begin(), _sources.end(),
+								  [&timings](const source& entry) { return entry.timings == &timings; }),
+				   _sources.end());
+}
+
+void xmr::utility::profiler::json_exporter::remove(histogram& buckets)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	_sources.erase(std::remove_if(_sources.begin(), _sources.end(),
+								  [&buckets](const source& entry) { return entry.buckets == &buckets; }),
+				   _sources.end());
+}
+
+void xmr::utility::profiler::json_exporter::add(uint32_t zone, throughput& rates)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	_rates.emplace_back(zone, &rates);
+}
+
+void xmr::utility::profiler::json_exporter::remove(throughput& rates)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	_rates.erase(std::remove_if(_rates.begin(), _rates.end(),
+								[&rates](const std::pair<uint32_t, throughput*>& entry) {
+									return entry.second == &rates;
+								}),
+				 _rates.end());
+}
+
+bool xmr::utility::profiler::json_exporter::write(int fd)
+{
+	json_exporter_fd sink = {fd};
+	return write(sink, nullptr);
+}
+
+void xmr::utility::profiler::json_exporter::write(std::string& output)
+{
+	output.clear();
+	json_exporter_string sink = {output};
+	write(sink, nullptr);
+}
+
+bool xmr::utility::profiler::json_exporter::write(int fd, reporter& source)
+{
+	json_exporter_fd sink = {fd};
+	return write(sink, &source);
+}
+
+void xmr::utility::profiler::json_exporter::write(std::string& output, reporter& source)
+{
+	output.clear();
+	json_exporter_string sink = {output};
+	write(sink, &source);
+}
+
+template<typename Sink>
+bool xmr::utility::profiler::json_exporter::write(Sink& sink, reporter* merged)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	json_exporter_stream<Sink>  out = {sink, _buffer.data(), 0, false};
+
+	out.literal("{\"zones\":[");
+	if (merged) {
+		size_t written = 0;
+		merged->run([&out, &written, merged](const reporter::report& entry) {
+			if (written++ != 0) {
+				out.literal(",");
+			}
+			json_exporter_zone(out, entry.zone, entry.count, entry.sum, entry.minimum, entry.maximum,
+							   merged->quantiles(), entry.values);
+			out.literal("}");
+		});
+	} else {
+		_values.resize(_quantiles.size());
+		for (size_t idx = 0; idx < _sources.size(); idx++) {
+			const source& entry = _sources[idx];
+
+			// Reduce both kinds of sources to ascending (value, count) pairs, so statistics are computed the same way.
+			_scratch.clear();
+			double   sum     = 0.;
+			uint64_t minimum = 0;
+			if (entry.timings) {
+				uint64_t total = 0;
+				entry.timings->visit([this, &total](uint64_t time, uint64_t count) {
+					_scratch.emplace_back(time, count);
+					total += time * count;
+				});
+				sum     = static_cast<double>(total);
+				minimum = _scratch.empty() ? 0 : _scratch.front().first;
+			} else {
+				// Buckets are reported by their highest value, same as histogram::percentile_events.
+				const uint64_t* counts = entry.buckets->counts();
+				for (size_t bucket = 0; bucket < entry.buckets->size(); bucket++) {
+					if (counts[bucket] != 0) {
+						if (_scratch.empty()) {
+							minimum = entry.buckets->lowest(bucket);
+						}
+						_scratch.emplace_back(entry.buckets->highest(bucket), counts[bucket]);
+					}
+				}
+				sum = entry.buckets->total_time();
+			}
+
+			uint64_t count = 0;
+			for (auto& pair : _scratch) {
+				count += pair.second;
+			}
+
+			// Quantiles are sorted, so a single walk finds all of them.
+			size_t   position = 0;
+			uint64_t accum    = _scratch.empty() ? 0 : _scratch.front().second;
+			for (size_t quantile = 0; quantile < _quantiles.size(); quantile++) {
+				double   exact = std::ceil(_quantiles[quantile] * static_cast<double>(count));
+				uint64_t rank  = exact < 1. ? 1 : static_cast<uint64_t>(exact);
+				while ((accum < rank) && ((position + 1) < _scratch.size())) {
+					accum += _scratch[++position].second;
+				}
+				_values[quantile] = count > 0 ? _scratch[position].first : 0;
+			}
+
+			if (idx != 0) {
+				out.literal(",");
+			}
+			json_exporter_zone(out, entry.zone, count, sum, minimum, count > 0 ? _scratch.back().first : 0, _quantiles,
+							   _values.data());
+
+			if (_buckets) {
+				out.literal(",\"buckets\":[");
+				for (size_t bucket = 0; bucket < _scratch.size(); bucket++) {
+					if (bucket != 0) {
+						out.literal(",");
+					}
+					out.literal("[");
+					out.integer(_scratch[bucket].first);
+					out.literal(",");
+					out.integer(_scratch[bucket].second);
+					out.literal("]");
+				}
+				out.literal("]");
+			}
+			out.literal("}");
+		}
+	}
+
+	out.literal("],\"objectives\":[");
+	slo::snapshot(_objectives);
+	for (size_t idx = 0; idx < _objectives.size(); idx++) {
+		const slo::status& state = _objectives[idx];
+		const char*        name  = registry::name(state.zone);
+		if (idx != 0) {
+			out.literal(",");
+		}
+		out.literal("{\"zone\":");
+		out.string(name ? name : "unknown");
+		out.literal(",\"threshold\":");
+		out.integer(state.threshold);
+		out.literal(",\"objective\":");
+		out.number(state.objective);
+		out.literal(",\"good\":");
+		out.integer(state.good);
+		out.literal(",\"bad\":");
+		out.integer(state.bad);
+		out.literal(",\"burn_rates\":[");
+		for (size_t window = 0; window < state.burn_rates.size(); window++) {
+			if (window != 0) {
+				out.literal(",");
+			}
+			out.number(state.burn_rates[window]);
+		}
+		out.literal("]}");
+	}
+	out.literal("]");
+
+	if (!_rates.empty()) {
+		out.literal(",\"throughput\":[");
+		for (size_t idx = 0; idx < _rates.size(); idx++) {
+			throughput& rates = *_rates[idx].second;
+			const char* name  = registry::name(_rates[idx].first);
+			uint64_t    count = rates.total_events();
+
+			// One snapshot for all quantiles, kept around so repeated exports do not allocate.
+			if (!_costs || (_costs->precision() != rates.precision())) {
+				_costs.reset(new histogram(rates.precision()));
+			} else {
+				_costs->clear();
+			}
+			rates.snapshot(*_costs);
+
+			if (idx != 0) {
+				out.literal(",");
+			}
+			out.literal("{\"zone\":");
+			out.string(name ? name : "unknown");
+			out.literal(",\"id\":");
+			out.integer(_rates[idx].first);
+			out.literal(",\"count\":");
+			out.integer(count);
+			out.literal(",\"time\":");
+			out.integer(rates.total_time());
+			out.literal(",\"units\":");
+			out.integer(rates.total_units());
+			out.literal(",\"average\":");
+			out.number(rates.average_throughput());
+			out.literal(",\"quantiles\":{");
+			for (size_t quantile = 0; quantile < _quantiles.size(); quantile++) {
+				if (quantile != 0) {
+					out.literal(",");
+				}
+				out.literal("\"");
+				out.number(_quantiles[quantile]);
+				out.literal("\":");
+				out.number(throughput::percentile_throughput(*_costs, _quantiles[quantile]));
+			}
+			out.literal("}}");
+		}
+		out.literal("]");
+	}
+
+	// Columns instead of one object per sample, which keeps long series compact.
+	resources::snapshot(_resources);
+	if (!_resources.empty()) {
+		out.literal(",\"resources\":{");
+		for (size_t column = 0; column < (sizeof(json_exporter_resources) / sizeof(json_exporter_resources[0]));
+			 column++) {
+			if (column != 0) {
+				out.literal(",");
+			}
+			out.string(json_exporter_resources[column].name);
+			out.literal(":[");
+			for (size_t idx = 0; idx < _resources.size(); idx++) {
+				if (idx != 0) {
+					out.literal(",");
+				}
+				out.integer(_resources[idx].*json_exporter_resources[column].field);
+			}
+			out.literal("]");
+		}
+		out.literal("}");
+	}
+	out.literal("}\n");
+
+	out.flush();
+	return !out.failed;
+}
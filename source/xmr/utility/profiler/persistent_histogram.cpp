@@ -0,0 +1,358 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/persistent_histogram.hpp"
+#include "xmr/utility/profiler/profiler.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace xmr::utility::profiler;
+
+/** Header at the start of the file, followed by the counters.
+ */
+struct xmr::utility::profiler::persistent_histogram::header {
+	char     magic[8];
+	uint32_t version;
+	uint32_t precision;
+	uint64_t buckets;
+	uint64_t created;  // Seconds since the epoch.
+	uint64_t opened;   // Number of times the file has been opened.
+	uint64_t checksum; // Of everything above.
+	uint8_t  reserved[16];
+};
+
+static const char     persistent_histogram_magic[8] = {'X', 'M', 'R', 'P', 'H', 'I', 'S', 'T'};
+static const uint32_t persistent_histogram_version  = 1;
+
+static uint64_t persistent_histogram_checksum(const void* data, size_t size)
+{
+	// FNV-1a, only meant to catch torn or foreign headers.
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t       hash  = 14695981039346656037ull;
+	for (size_t idx = 0; idx < size; idx++) {
+		hash ^= bytes[idx];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/** Thread that flushes all persistent histograms with a sync interval.
+ *
+ * Histograms are flushed one at a time without the lock held, so a slow disk does not block registration. A histogram
+ * that is being removed waits until it is no longer the one being flushed.
+ */
+struct persistent_histogram_syncer {
+	struct entry {
+		persistent_histogram*                 target;
+		std::chrono::nanoseconds              interval;
+		std::chrono::steady_clock::time_point due;
+	};
+
+	std::mutex              lock;
+	std::condition_variable signal;
+	std::thread             thread;
+	bool                    stop;
+	std::vector<entry>      entries;
+	persistent_histogram*   current; // Being flushed right now, or nullptr.
+
+	persistent_histogram_syncer() : lock(), signal(), thread(), stop(false), entries(), current(nullptr) {}
+
+	// A thread still running at exit must be joined, destroying it while joinable terminates the process.
+	~persistent_histogram_syncer()
+	{
+		{
+			std::lock_guard<std::mutex> l(lock);
+			stop = true;
+		}
+		signal.notify_all();
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+
+	void add(persistent_histogram* target, uint64_t interval)
+	{
+		std::lock_guard<std::mutex> l(lock);
+		entry                       fresh;
+		fresh.target   = target;
+		fresh.interval = std::chrono::nanoseconds(interval);
+		fresh.due      = std::chrono::steady_clock::now() + fresh.interval;
+		entries.push_back(fresh);
+		if (!thread.joinable()) {
+			thread = std::thread([this]() { run(); });
+		}
+		signal.notify_all();
+	}
+
+	void remove(persistent_histogram* target)
+	{
+		std::unique_lock<std::mutex> ul(lock);
+		for (auto itr = entries.begin(); itr != entries.end(); itr++) {
+			if (itr->target == target) {
+				entries.erase(itr);
+				break;
+			}
+		}
+		while (current == target) {
+			signal.wait(ul);
+		}
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> ul(lock);
+		while (!stop) {
+			// Flush the histogram that is due first, if it is due already.
+			entry* next = nullptr;
+			for (auto& item : entries) {
+				if (!next || (item.due < next->due)) {
+					next = &item;
+				}
+			}
+			if (!next) {
+				signal.wait(ul);
+				continue;
+			}
+			auto now = std::chrono::steady_clock::now();
+			if (next->due > now) {
+				signal.wait_until(ul, next->due);
+				continue;
+			}
+
+			next->due = now + next->interval;
+			current   = next->target;
+			ul.unlock();
+			current->sync();
+			ul.lock();
+			current = nullptr;
+			signal.notify_all();
+		}
+	}
+};
+
+static persistent_histogram_syncer& persistent_histogram_sync_instance()
+{
+	static persistent_histogram_syncer syncer;
+	return syncer;
+}
+
+xmr::utility::profiler::persistent_histogram::~persistent_histogram()
+{
+	if (_sync_interval > 0) {
+		persistent_histogram_sync_instance().remove(this);
+	}
+
+	if (_mapping) {
+		sync();
+	}
+
+#ifdef _WIN32
+	if (_mapping) {
+		UnmapViewOfFile(_mapping);
+	}
+	if (_section) {
+		CloseHandle(_section);
+	}
+	if (_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(_file);
+	}
+#else
+	if (_mapping) {
+		munmap(_mapping, _size);
+	}
+	if (_file >= 0) {
+		close(_file);
+	}
+#endif
+}
+
+xmr::utility::profiler::persistent_histogram::persistent_histogram(const char* path, uint32_t precision,
+																   uint64_t sync_interval)
+	: _path(path), _precision(), _restored(false), _mapping(nullptr), _size(0), _counts(nullptr), _sync_interval(0),
+#ifdef _WIN32
+	  _file(INVALID_HANDLE_VALUE), _section(nullptr)
+#else
+	  _file(-1)
+#endif
+{
+	if (precision < 1) {
+		precision = 1;
+	} else if (precision > 20) {
+		precision = 20;
+	}
+	_precision = precision;
+
+	size_t buckets = histogram::size(_precision);
+	_size          = sizeof(header) + buckets * sizeof(uint64_t);
+
+	// Only continue a file of exactly the expected size, anything else is reset to zeros.
+#ifdef _WIN32
+	_file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS,
+						FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+
+	LARGE_INTEGER file_size;
+	bool          resize = !GetFileSizeEx(_file, &file_size) || (static_cast<size_t>(file_size.QuadPart) != _size);
+	if (resize) {
+		LARGE_INTEGER position;
+		position.QuadPart = 0;
+		SetFilePointerEx(_file, position, nullptr, FILE_BEGIN);
+		SetEndOfFile(_file);
+		position.QuadPart = static_cast<LONGLONG>(_size);
+		if (!SetFilePointerEx(_file, position, nullptr, FILE_BEGIN) || !SetEndOfFile(_file)) {
+			return;
+		}
+	}
+
+	_section = CreateFileMappingA(_file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+	if (!_section) {
+		return;
+	}
+	_mapping = MapViewOfFile(_section, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (!_mapping) {
+		return;
+	}
+#else
+	_file = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (_file < 0) {
+		return;
+	}
+
+	struct stat info;
+	bool        resize = (fstat(_file, &info) != 0) || (static_cast<size_t>(info.st_size) != _size);
+	if (resize) {
+		if ((ftruncate(_file, 0) != 0) || (ftruncate(_file, static_cast<off_t>(_size)) != 0)) {
+			return;
+		}
+	}
+
+	void* mapping = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _file, 0);
+	if (mapping == MAP_FAILED) {
+		return;
+	}
+	_mapping = mapping;
+#endif
+
+	header* head = static_cast<header*>(_mapping);
+	_restored    = !resize && (std::memcmp(head->magic, persistent_histogram_magic, sizeof(head->magic)) == 0)
+				&& (head->version == persistent_histogram_version) && (head->precision == _precision)
+				&& (head->buckets == buckets)
+				&& (head->checksum == persistent_histogram_checksum(head, offsetof(header, checksum)));
+	if (!_restored) {
+		std::memset(_mapping, 0, _size);
+		std::memcpy(head->magic, persistent_histogram_magic, sizeof(head->magic));
+		head->version   = persistent_histogram_version;
+		head->precision = _precision;
+		head->buckets   = buckets;
+		head->created   = static_cast<uint64_t>(std::time(nullptr));
+	}
+	head->opened++;
+	head->checksum = persistent_histogram_checksum(head, offsetof(header, checksum));
+
+	_counts = reinterpret_cast<std::atomic<uint64_t>*>(static_cast<uint8_t*>(_mapping) + sizeof(header));
+
+	if (sync_interval > 0) {
+		// Registering creates the shared thread before this histogram is complete, so it outlives it at exit.
+		_sync_interval = sync_interval;
+		persistent_histogram_sync_instance().add(this, sync_interval);
+	}
+}
+
+uint64_t xmr::utility::profiler::persistent_histogram::track(uint64_t time_end, uint64_t time_start)
+{
+	uint64_t difference = elapsed(time_end, time_start);
+
+	record(difference);
+	return difference;
+}
+
+void xmr::utility::profiler::persistent_histogram::clear()
+{
+	if (!_counts) {
+		return;
+	}
+
+	size_t buckets = histogram::size(_precision);
+	for (size_t idx = 0; idx < buckets; idx++) {
+		_counts[idx].store(0, std::memory_order_relaxed);
+	}
+}
+
+void xmr::utility::profiler::persistent_histogram::snapshot(histogram& target)
+{
+	if (!_counts) {
+		return;
+	}
+
+	histogram  local(_precision);
+	histogram& output = (target.precision() == _precision) ? target : local;
+
+	size_t buckets = histogram::size(_precision);
+	for (size_t idx = 0; idx < buckets; idx++) {
+		uint64_t count = _counts[idx].load(std::memory_order_relaxed);
+		if (count != 0) {
+			output.record(histogram::lowest(idx, _precision), count);
+		}
+	}
+
+	if (&output == &local) {
+		local.resample(target);
+	}
+}
+
+bool xmr::utility::profiler::persistent_histogram::sync()
+{
+	if (!_mapping) {
+		return false;
+	}
+
+#ifdef _WIN32
+	return FlushViewOfFile(_mapping, 0) && FlushFileBuffers(_file);
+#else
+	return msync(_mapping, _size, MS_SYNC) == 0;
+#endif
+}
+
+uint64_t xmr::utility::profiler::persistent_histogram::total_events()
+{
+	if (!_counts) {
+		return 0;
+	}
+
+	uint64_t total   = 0;
+	size_t   buckets = histogram::size(_precision);
+	for (size_t idx = 0; idx < buckets; idx++) {
+		total += _counts[idx].load(std::memory_order_relaxed);
+	}
+	return total;
+}
@@ -0,0 +1,241 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/quantile.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace xmr::utility::profiler;
+
+// p is held in units of 1e-9, which represents every decimal quantile in use exactly.
+static const int64_t quantile_scale = 1000000000;
+
+// Tails whose expected number of values is at most this are solved exactly, beyond the normal approximation is used.
+static const double quantile_exact_limit = 500.;
+
+/** Position of a quantile between two order statistics, counting from 1.
+ */
+struct quantile_position {
+	int64_t rank;   // Lower order statistic, may lie outside of 1 to count.
+	double  weight; // Weight of the order statistic above rank, from 0 to 1.
+};
+
+static int64_t quantile_floor_divide(int64_t numerator, int64_t denominator)
+{
+	int64_t result = numerator / denominator;
+	return ((numerator % denominator) < 0) ? (result - 1) : result;
+}
+
+static quantile_position quantile_locate(uint64_t count, double p, quantile_definition definition)
+{
+	// Every definition places the quantile at h = (count + a) * p + b, with a and b in 24ths. Computing h in
+	// integers keeps exact ranks exact, which decides between two values for the discontinuous definitions.
+	static const int64_t offsets[10][2] = {{0, 0},  {0, 0},   {0, 0},   {0, -12},  {0, 0},
+										   {0, 12}, {24, 0},  {-24, 24}, {8, 8},   {6, 9}};
+
+	int64_t scaled = static_cast<int64_t>(std::llround(std::min(std::max(p, 0.), 1.) * quantile_scale));
+	size_t  index  = std::min<size_t>(static_cast<size_t>(definition), 9);
+
+	// count * p split into a whole part and a remainder in units of 1e-9, without overflowing.
+	uint64_t low       = (count % quantile_scale) * static_cast<uint64_t>(scaled);
+	int64_t  whole     = static_cast<int64_t>((count / quantile_scale) * scaled + low / quantile_scale);
+	int64_t  remainder = static_cast<int64_t>(low % quantile_scale);
+
+	int64_t denominator = 24 * quantile_scale;
+	int64_t fraction    = 24 * remainder + offsets[index][0] * scaled + offsets[index][1] * quantile_scale;
+	int64_t carry       = quantile_floor_divide(fraction, denominator);
+	fraction -= carry * denominator;
+
+	quantile_position position;
+	position.rank = whole + carry;
+	switch (definition) {
+	case quantile_definition::inverted_cdf:
+		position.weight = (fraction > 0) ? 1. : 0.;
+		break;
+	case quantile_definition::averaged_inverted_cdf:
+		position.weight = (fraction > 0) ? 1. : 0.5;
+		break;
+	case quantile_definition::closest_observation:
+		position.weight = ((fraction == 0) && ((position.rank % 2) == 0)) ? 0. : 1.;
+		break;
+	default:
+		position.weight = static_cast<double>(fraction) / static_cast<double>(denominator);
+		break;
+	}
+	return position;
+}
+
+/** Ranks of the order statistics bounding a distribution-free confidence interval of a quantile.
+ *
+ * The number of values below the true quantile follows a binomial distribution, so the interval is found from its
+ * tails. Ranks outside of 1 to count mean the interval is not bounded on that side.
+ */
+static void quantile_interval(uint64_t count, double p, double confidence, int64_t& lower, int64_t& upper)
+{
+	double n     = static_cast<double>(count);
+	double alpha = (1. - std::min(std::max(confidence, 0.), 1.)) / 2.;
+	p            = std::min(std::max(p, 0.), 1.);
+
+	// Walk the binomial distribution of the smaller side, for p99 that is the number of values above the quantile.
+	double tail = std::min(p, 1. - p);
+	if ((n * tail) <= quantile_exact_limit) {
+		double  mass       = std::exp(n * std::log1p(-tail));
+		double  ratio      = tail / (1. - tail);
+		double  cumulative = 0.;
+		int64_t below      = -1; // Highest k with P(X <= k) <= alpha.
+		int64_t above      = static_cast<int64_t>(count); // Lowest k with P(X <= k) >= 1 - alpha.
+		for (int64_t k = 0; k <= static_cast<int64_t>(count); k++) {
+			cumulative += mass;
+			if (cumulative <= alpha) {
+				below = k;
+			}
+			if (cumulative >= (1. - alpha)) {
+				above = k;
+				break;
+			}
+			mass *= ratio * (n - static_cast<double>(k)) / static_cast<double>(k + 1);
+		}
+
+		if (p < 0.5) {
+			lower = below + 1;
+			upper = above + 1;
+		} else {
+			lower = static_cast<int64_t>(count) - above;
+			upper = static_cast<int64_t>(count) - below;
+		}
+		return;
+	}
+
+	// Inverse of the standard normal distribution, Abramowitz and Stegun 26.2.23.
+	double t = std::sqrt(-2. * std::log(std::max(alpha, 1e-300)));
+	double z = t - (2.515517 + 0.802853 * t + 0.010328 * t * t)
+					   / (1. + 1.432788 * t + 0.189269 * t * t + 0.001308 * t * t * t);
+
+	double spread = z * std::sqrt(n * p * (1. - p));
+	lower         = static_cast<int64_t>(std::floor(n * p - spread));
+	upper         = static_cast<int64_t>(std::ceil(n * p + spread)) + 1;
+}
+
+/** Order statistics of a profiler, fetched in a single walk.
+ *
+ * @param ranks Ranks to fetch, ascending and within 1 to count.
+ */
+static void quantile_fetch(xmr::utility::profiler::profiler& source, const int64_t* ranks, double* values,
+						   size_t size)
+{
+	size_t   next  = 0;
+	uint64_t accum = 0;
+	source.visit([&](uint64_t time, uint64_t count) {
+		accum += count;
+		while ((next < size) && (static_cast<uint64_t>(ranks[next]) <= accum)) {
+			values[next++] = static_cast<double>(time);
+		}
+	});
+}
+
+/** Order statistics of a histogram, with the values of a bucket spread evenly across it.
+ */
+static void quantile_fetch(const histogram& source, const int64_t* ranks, double* values, size_t size)
+{
+	const uint64_t* counts = source.counts();
+	size_t          next   = 0;
+	uint64_t        accum  = 0;
+	for (size_t bucket = 0; (bucket < source.size()) && (next < size); bucket++) {
+		if (counts[bucket] == 0) {
+			continue;
+		}
+
+		double lowest = static_cast<double>(source.lowest(bucket));
+		double width  = static_cast<double>(source.highest(bucket)) - lowest;
+		double share  = static_cast<double>(counts[bucket]);
+		while ((next < size) && (static_cast<uint64_t>(ranks[next]) <= (accum + counts[bucket]))) {
+			double offset  = static_cast<double>(static_cast<uint64_t>(ranks[next]) - accum) - 0.5;
+			values[next++] = lowest + width * offset / share;
+		}
+		accum += counts[bucket];
+	}
+}
+
+template<typename Source>
+static quantile_estimate quantile_estimate_of(Source& source, uint64_t count, double p, double confidence,
+											  quantile_definition definition, bool interval)
+{
+	quantile_estimate result = {0., 0., 0., false};
+	if (count == 0) {
+		return result;
+	}
+
+	auto clamp = [count](int64_t rank) { return std::min(std::max<int64_t>(rank, 1), static_cast<int64_t>(count)); };
+
+	quantile_position position = quantile_locate(count, p, definition);
+	int64_t           ranks[4] = {clamp(position.rank), clamp(position.rank + 1), 0, 0};
+	size_t            size     = 2;
+	int64_t           lower    = 0;
+	int64_t           upper    = 0;
+	if (interval) {
+		quantile_interval(count, p, confidence, lower, upper);
+		result.bounded = (lower >= 1) && (upper <= static_cast<int64_t>(count));
+		ranks[2]       = clamp(lower);
+		ranks[3]       = clamp(upper);
+		size           = 4;
+	}
+
+	// Fetch all order statistics in one walk, then put them back in place.
+	int64_t sorted[4];
+	double  fetched[4] = {0., 0., 0., 0.}; // Stays 0 if the source was cleared in the meantime.
+	for (size_t idx = 0; idx < size; idx++) {
+		// Insertion sort, std::sort trips -Warray-bounds on arrays this small.
+		size_t slot = idx;
+		while ((slot > 0) && (sorted[slot - 1] > ranks[idx])) {
+			sorted[slot] = sorted[slot - 1];
+			slot--;
+		}
+		sorted[slot] = ranks[idx];
+	}
+	quantile_fetch(source, sorted, fetched, size);
+	auto value = [&](int64_t rank) { return fetched[std::lower_bound(sorted, sorted + size, rank) - sorted]; };
+
+	double below = value(ranks[0]);
+	result.value = below + position.weight * (value(ranks[1]) - below);
+	if (interval) {
+		result.lower = value(ranks[2]);
+		result.upper = value(ranks[3]);
+	}
+	return result;
+}
+
+double xmr::utility::profiler::quantile(xmr::utility::profiler::profiler& source, double p,
+										quantile_definition definition)
+{
+	return quantile_estimate_of(source, source.total_events(), p, 0., definition, false).value;
+}
+
+double xmr::utility::profiler::quantile(const histogram& source, double p, quantile_definition definition)
+{
+	return quantile_estimate_of(source, source.total_events(), p, 0., definition, false).value;
+}
+
+quantile_estimate xmr::utility::profiler::quantile(xmr::utility::profiler::profiler& source, double p,
+												   double confidence, quantile_definition definition)
+{
+	return quantile_estimate_of(source, source.total_events(), p, confidence, definition, true);
+}
+
+quantile_estimate xmr::utility::profiler::quantile(const histogram& source, double p, double confidence,
+												   quantile_definition definition)
+{
+	return quantile_estimate_of(source, source.total_events(), p, confidence, definition, true);
+}
@@ -0,0 +1,297 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/registry.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <set>
+#include <thread>
+
+using namespace xmr::utility::profiler;
+
+/** Interned name, allocated from the arena and never freed.
+ *
+ * The identifier starts out as invalid_zone and is published with release semantics once it has been assigned, so a
+ * thread that finds the entry in the table only has to wait for the short window between the two.
+ */
+struct registry_entry {
+	uint64_t              hash;
+	size_t                length;
+	std::atomic<uint32_t> id;
+	char                  name[1];
+};
+
+/** Chunk of the append-only arena that holds all entries.
+ */
+struct registry_chunk {
+	registry_chunk*     next;
+	size_t              size;
+	std::atomic<size_t> used;
+	char                data[1];
+};
+
+static const size_t registry_slots      = registry::capacity * 2; // Keeps the load factor at or below one half.
+static const size_t registry_chunk_size = 65536;
+
+// Zones may be registered from static initializers of other modules, so all state here must be constant-initialized.
+static std::atomic<registry_entry*> registry_table[registry_slots];
+static std::atomic<const char*>     registry_names[registry::capacity];
+static std::atomic<registry_chunk*> registry_arena(nullptr);
+static std::atomic<uint32_t>        registry_reserved(0); // Identifiers taken or about to be taken, except overflow.
+static std::atomic<uint32_t>        registry_dynamic(0);  // Part of the above taken by zone(), subject to the limit.
+static std::atomic<uint32_t>        registry_next(0);     // Next identifier to assign.
+static std::atomic<uint32_t>        registry_limit(registry::capacity - 1);
+static std::atomic<uint32_t>        registry_overflow_id(registry::invalid_zone);
+static std::atomic<uint64_t>        registry_overflowed(0);
+
+static uint64_t registry_hash(const char* name, size_t length)
+{
+	// FNV-1a, names are short so anything stronger is not worth it.
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t idx = 0; idx < length; idx++) {
+		hash ^= static_cast<uint8_t>(name[idx]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static void* registry_allocate(size_t size)
+{
+	size = (size + alignof(registry_entry) - 1) & ~(alignof(registry_entry) - 1);
+	while (true) {
+		registry_chunk* chunk = registry_arena.load(std::memory_order_acquire);
+		if (chunk) {
+			size_t offset = chunk->used.fetch_add(size, std::memory_order_relaxed);
+			if (offset + size <= chunk->size) {
+				return chunk->data + offset;
+			}
+		}
+
+		// Out of space, so try to install a fresh chunk. Whoever loses the race frees theirs and retries.
+		size_t capacity = size > registry_chunk_size ? size : registry_chunk_size;
+		void*  memory   = ::operator new(sizeof(registry_chunk) + capacity);
+		auto   fresh    = new (memory) registry_chunk;
+		fresh->next     = chunk;
+		fresh->size     = capacity;
+		fresh->used.store(0, std::memory_order_relaxed);
+		if (!registry_arena.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)) {
+			fresh->~registry_chunk();
+			::operator delete(memory);
+		}
+	}
+}
+
+static uint32_t registry_wait(registry_entry* entry)
+{
+	uint32_t id;
+	while ((id = entry->id.load(std::memory_order_acquire)) == registry::invalid_zone) {
+		std::this_thread::yield();
+	}
+	return id;
+}
+
+static bool registry_matches(registry_entry* entry, uint64_t hash, const char* name, size_t length)
+{
+	return (entry->hash == hash) && (entry->length == length) && (std::memcmp(entry->name, name, length) == 0);
+}
+
+/** How a new name is accounted for.
+ */
+enum registry_kind {
+	registry_kind_dynamic,  // Registered by zone(), counts against the limit.
+	registry_kind_static,   // Declared in code, only bounded by the capacity.
+	registry_kind_overflow, // The overflow zone itself, which has the last identifier held back for it.
+};
+
+static bool registry_reserve(registry_kind kind, uint32_t limit)
+{
+	if (kind == registry_kind_overflow) {
+		return true;
+	}
+	if ((kind == registry_kind_dynamic) && (registry_dynamic.fetch_add(1, std::memory_order_relaxed) >= limit)) {
+		registry_dynamic.fetch_sub(1, std::memory_order_relaxed);
+		return false;
+	}
+	if (registry_reserved.fetch_add(1, std::memory_order_relaxed) >= registry::capacity - 1) {
+		registry_reserved.fetch_sub(1, std::memory_order_relaxed);
+		if (kind == registry_kind_dynamic) {
+			registry_dynamic.fetch_sub(1, std::memory_order_relaxed);
+		}
+		return false;
+	}
+	return true;
+}
+
+static void registry_release(registry_kind kind)
+{
+	if (kind == registry_kind_overflow) {
+		return;
+	}
+	registry_reserved.fetch_sub(1, std::memory_order_relaxed);
+	if (kind == registry_kind_dynamic) {
+		registry_dynamic.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
+
+static uint32_t registry_overflow();
+
+/** Find or insert a name.
+ *
+ * Lookups of existing names only read the table and never wait once the name has been published. Insertions claim an
+ * empty slot with a single compare-and-swap, and names that would exceed the limit are folded into the overflow zone.
+ * The table has twice as many slots as identifiers, so there is always an empty slot for the overflow zone.
+ */
+static uint32_t registry_insert(const char* name, size_t length, registry_kind kind, uint32_t limit)
+{
+	uint64_t        hash  = registry_hash(name, length);
+	size_t          slot  = static_cast<size_t>(hash) & (registry_slots - 1);
+	registry_entry* fresh = nullptr;
+
+	while (true) {
+		registry_entry* entry = registry_table[slot].load(std::memory_order_acquire);
+		if (entry) {
+			if (registry_matches(entry, hash, name, length)) {
+				if (fresh) {
+					// Lost the slot to the same name, give the reservation back. The arena memory is not reused.
+					registry_release(kind);
+				}
+				return registry_wait(entry);
+			}
+			slot = (slot + 1) & (registry_slots - 1);
+			continue;
+		}
+
+		if (!fresh) {
+			if (!registry_reserve(kind, limit)) {
+				registry_overflowed.fetch_add(1, std::memory_order_relaxed);
+				return registry_overflow();
+			}
+
+			fresh         = new (registry_allocate(sizeof(registry_entry) + length)) registry_entry;
+			fresh->hash   = hash;
+			fresh->length = length;
+			fresh->id.store(registry::invalid_zone, std::memory_order_relaxed);
+			std::memcpy(fresh->name, name, length);
+			fresh->name[length] = '\0';
+		}
+
+		if (registry_table[slot].compare_exchange_strong(entry, fresh, std::memory_order_acq_rel)) {
+			uint32_t id = registry_next.fetch_add(1, std::memory_order_relaxed);
+			registry_names[id].store(fresh->name, std::memory_order_release);
+			fresh->id.store(id, std::memory_order_release);
+			return id;
+		}
+		// Someone else claimed the slot first, look at what they put there.
+	}
+}
+
+static uint32_t registry_overflow()
+{
+	uint32_t id = registry_overflow_id.load(std::memory_order_acquire);
+	if (id == registry::invalid_zone) {
+		// The last identifier is held back for this zone, so it can always be created without a reservation.
+		static const char name[] = "(overflow)";
+		id                       = registry_insert(name, sizeof(name) - 1, registry_kind_overflow, 0);
+		registry_overflow_id.store(id, std::memory_order_release);
+	}
+	return id;
+}
+
+static std::mutex& registry_lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+static std::set<registry::descriptor*>& registry_ranges()
+{
+	static std::set<registry::descriptor*> ranges;
+	return ranges;
+}
+
+uint32_t xmr::utility::profiler::registry::zone(const char* name)
+{
+	uint32_t limit = registry_limit.load(std::memory_order_relaxed);
+	return registry_insert(name, std::strlen(name), registry_kind_dynamic, limit);
+}
+
+uint32_t xmr::utility::profiler::registry::zone(const char* name, size_t length)
+{
+	return registry_insert(name, length, registry_kind_dynamic, registry_limit.load(std::memory_order_relaxed));
+}
+
+void xmr::utility::profiler::registry::enumerate(descriptor* begin, descriptor* end)
+{
+	// Only serializes startup of modules against each other, lookups never take this lock.
+	std::lock_guard<std::mutex> l(registry_lock());
+	if (!registry_ranges().insert(begin).second) {
+		return;
+	}
+
+	// Static zones are bounded by the code itself, so they neither count against nor are subject to the limit.
+	for (descriptor* zone = begin; zone < end; zone++) {
+		zone->id.store(registry_insert(zone->name, std::strlen(zone->name), registry_kind_static, 0),
+					   std::memory_order_relaxed);
+	}
+}
+
+const char* xmr::utility::profiler::registry::name(uint32_t id)
+{
+	if (id >= registry::capacity) {
+		return nullptr;
+	}
+	return registry_names[id].load(std::memory_order_acquire);
+}
+
+uint32_t xmr::utility::profiler::registry::count()
+{
+	return registry_next.load(std::memory_order_acquire);
+}
+
+void xmr::utility::profiler::registry::limit(uint32_t zones)
+{
+	if (zones > registry::capacity - 1) {
+		zones = registry::capacity - 1;
+	}
+	registry_limit.store(zones, std::memory_order_relaxed);
+}
+
+uint32_t xmr::utility::profiler::registry::overflow()
+{
+	return registry_overflow();
+}
+
+uint64_t xmr::utility::profiler::registry::overflowed()
+{
+	return registry_overflowed.load(std::memory_order_relaxed);
+}
+
+#ifdef XMR_UTILITY_PROFILER_ZONE_SECTION
+// The hidden symbols bound the section of the module this file is linked into. Runs ahead of ordinary static
+// initializers, so zones are usable from them.
+extern "C" {
+extern registry::descriptor __start_xmr_utility_profiler_zones[] __attribute__((weak, visibility("hidden")));
+extern registry::descriptor __stop_xmr_utility_profiler_zones[] __attribute__((weak, visibility("hidden")));
+}
+
+__attribute__((constructor(101))) static void registry_enumerate_zones()
+{
+	if (&__start_xmr_utility_profiler_zones[0] != &__stop_xmr_utility_profiler_zones[0]) {
+		registry::enumerate(__start_xmr_utility_profiler_zones, __stop_xmr_utility_profiler_zones);
+	}
+}
+#endif
@@ -0,0 +1,299 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/reporter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace xmr::utility::profiler;
+
+/** Scratch space of a thread taking part in a run.
+ */
+struct xmr::utility::profiler::reporter::worker {
+	std::vector<uint64_t> counts; // Merged buckets of the current zone, all 0 between zones.
+	histogram             resampled;
+
+	worker(uint32_t precision) : counts(histogram::size(precision), 0), resampled(precision) {}
+};
+
+xmr::utility::profiler::reporter::~reporter()
+{
+	{
+		std::lock_guard<std::mutex> l(_lock);
+		_stop = true;
+	}
+	_signal.notify_all();
+	for (auto& thread : _threads) {
+		thread.join();
+	}
+}
+
+xmr::utility::profiler::reporter::reporter(const std::vector<double>& quantiles, uint32_t precision, size_t threads,
+										   size_t chunk)
+	: _run_lock(), _zones(), _quantiles(quantiles), _precision(precision), _chunk(std::max<size_t>(chunk, 1)),
+	  _reports(), _values(), _ready(), _ready_count(0), _lock(), _signal(), _done(), _stop(false), _generation(0),
+	  _active(0), _chunks(0), _next(0), _workers(), _threads()
+{
+	if (_precision < 1) {
+		_precision = 1;
+	} else if (_precision > 20) {
+		_precision = 20;
+	}
+	std::sort(_quantiles.begin(), _quantiles.end());
+
+	if (threads == size_t(-1)) {
+		size_t hardware = std::thread::hardware_concurrency();
+		threads         = hardware > 1 ? std::min<size_t>(hardware - 1, 7) : 0;
+	}
+
+	// The first scratch space belongs to the thread calling run().
+	for (size_t idx = 0; idx <= threads; idx++) {
+		_workers.emplace_back(new worker(_precision));
+	}
+	for (size_t idx = 1; idx <= threads; idx++) {
+		_threads.emplace_back([this, idx]() { work(idx); });
+	}
+}
+
+void xmr::utility::profiler::reporter::add(uint32_t zone, xmr::utility::profiler::profiler& timings)
+{
+	std::lock_guard<std::mutex> l(_run_lock);
+	auto                        entry = std::lower_bound(_zones.begin(), _zones.end(), zone,
+                                  [](const zone_sources& sources, uint32_t id) { return sources.zone < id; });
+	if ((entry == _zones.end()) || (entry->zone != zone)) {
+		entry = _zones.insert(entry, zone_sources{zone, {}, {}});
+	}
+	entry->timings.push_back(&timings);
+}
+
+void xmr::utility::profiler::reporter::add(uint32_t zone, histogram& buckets)
+{
+	std::lock_guard<std::mutex> l(_run_lock);
+	auto                        entry = std::lower_bound(_zones.begin(), _zones.end(), zone,
+                                  [](const zone_sources& sources, uint32_t id) { return sources.zone < id; });
+	if ((entry == _zones.end()) || (entry->zone != zone)) {
+		entry = _zones.insert(entry, zone_sources{zone, {}, {}});
+	}
+	entry->buckets.push_back(&buckets);
+}
+
+void xmr::utility::profiler::reporter::remove(xmr::utility::profiler::profiler& timings)
+{
+	std::lock_guard<std::mutex> l(_run_lock);
+	for (auto& sources : _zones) {
+		sources.timings.erase(std::remove(sources.timings.begin(), sources.timings.end(), &timings),
+							  sources.timings.end());
+	}
+	_zones.erase(std::remove_if(_zones.begin(), _zones.end(),
+								[](const zone_sources& sources) {
+									return sources.timings.empty() && sources.buckets.empty();
+								}),
+				 _zones.end());
+}
+
+void xmr::utility::profiler::reporter::remove(histogram& buckets)
+{
+	std::lock_guard<std::mutex> l(_run_lock);
+	for (auto& sources : _zones) {
+		sources.buckets.erase(std::remove(sources.buckets.begin(), sources.buckets.end(), &buckets),
+							  sources.buckets.end());
+	}
+	_zones.erase(std::remove_if(_zones.begin(), _zones.end(),
+								[](const zone_sources& sources) {
+									return sources.timings.empty() && sources.buckets.empty();
+								}),
+				 _zones.end());
+}
+
+size_t xmr::utility::profiler::reporter::run(const callback_t& callback)
+{
+	std::lock_guard<std::mutex> rl(_run_lock);
+
+	size_t zones  = _zones.size();
+	size_t chunks = (zones + _chunk - 1) / _chunk;
+	_reports.resize(zones);
+	_values.resize(zones * _quantiles.size());
+	if (chunks > _ready_count) {
+		// Generations start at 1, so a new array never looks finished.
+		_ready.reset(new std::atomic<uint64_t>[chunks]);
+		for (size_t idx = 0; idx < chunks; idx++) {
+			_ready[idx].store(0, std::memory_order_relaxed);
+		}
+		_ready_count = chunks;
+	}
+
+	uint64_t generation;
+	{
+		std::lock_guard<std::mutex> l(_lock);
+		generation = ++_generation;
+		_chunks.store(chunks, std::memory_order_relaxed);
+		_next.store(generation << 32, std::memory_order_release);
+	}
+	_signal.notify_all();
+
+	// Report chunks in order, and help with merging while the next one is not done yet.
+	worker& state = *_workers[0];
+	for (size_t chunk = 0; chunk < chunks; chunk++) {
+		while (_ready[chunk].load(std::memory_order_acquire) != generation) {
+			if (!process(state, generation)) {
+				std::unique_lock<std::mutex> ul(_lock);
+				_done.wait(ul, [this, chunk, generation]() {
+					return _ready[chunk].load(std::memory_order_acquire) == generation;
+				});
+			}
+		}
+
+		size_t end = std::min(zones, (chunk + 1) * _chunk);
+		for (size_t idx = chunk * _chunk; idx < end; idx++) {
+			callback(_reports[idx]);
+		}
+	}
+
+	// Workers may still be looking for more chunks, wait for them before the zones can change again.
+	std::unique_lock<std::mutex> ul(_lock);
+	_done.wait(ul, [this]() { return _active == 0; });
+	return zones;
+}
+
+void xmr::utility::profiler::reporter::work(size_t index)
+{
+	worker&                      state = *_workers[index];
+	uint64_t                     seen  = 0;
+	std::unique_lock<std::mutex> ul(_lock);
+	while (true) {
+		_signal.wait(ul, [this, &seen]() { return _stop || (_generation != seen); });
+		if (_stop) {
+			return;
+		}
+		seen = _generation;
+		_active++;
+
+		ul.unlock();
+		while (process(state, seen)) {
+		}
+		ul.lock();
+
+		_active--;
+		_done.notify_all();
+	}
+}
+
+bool xmr::utility::profiler::reporter::process(worker& state, uint64_t generation)
+{
+	// A worker can wake up for a run that has already finished. Claiming through the generation stops it from taking
+	// a chunk of the next run and marking it with the wrong generation.
+	uint64_t cursor = _next.load(std::memory_order_acquire);
+	size_t   chunk;
+	do {
+		chunk = static_cast<size_t>(cursor & 0xFFFFFFFFull);
+		if (((cursor >> 32) != (generation & 0xFFFFFFFFull)) || (chunk >= _chunks.load(std::memory_order_relaxed))) {
+			return false;
+		}
+	} while (!_next.compare_exchange_weak(cursor, cursor + 1, std::memory_order_acquire, std::memory_order_acquire));
+
+	size_t end = std::min(_zones.size(), (chunk + 1) * _chunk);
+	for (size_t idx = chunk * _chunk; idx < end; idx++) {
+		merge(state, idx);
+	}
+	_ready[chunk].store(generation, std::memory_order_release);
+
+	// Taking the lock orders the store before a waiting run() checks it again, so the wakeup is not lost.
+	{
+		std::lock_guard<std::mutex> l(_lock);
+	}
+	_done.notify_all();
+	return true;
+}
+
+void xmr::utility::profiler::reporter::merge(worker& state, size_t index)
+{
+	const zone_sources& sources = _zones[index];
+	uint64_t*           counts  = state.counts.data();
+	size_t              lowest  = std::numeric_limits<size_t>::max();
+	size_t              highest = 0;
+	uint64_t            count   = 0;
+	uint64_t            exact   = 0; // Sum of profiler timings, which are exact.
+	double              sum     = 0.;
+	uint64_t            minimum = std::numeric_limits<uint64_t>::max();
+	uint64_t            maximum = 0;
+
+	for (auto timings : sources.timings) {
+		timings->visit([&](uint64_t time, uint64_t events) {
+			size_t bucket = histogram::index(time, _precision);
+			counts[bucket] += events;
+			lowest  = std::min(lowest, bucket);
+			highest = std::max(highest, bucket);
+			count += events;
+			exact += time * events;
+			minimum = std::min(minimum, time);
+			maximum = std::max(maximum, time);
+		});
+	}
+
+	for (auto buckets : sources.buckets) {
+		const histogram* source = buckets;
+		if (buckets->precision() != _precision) {
+			state.resampled.clear();
+			buckets->resample(state.resampled);
+			source = &state.resampled;
+		}
+
+		const uint64_t* values = source->counts();
+		for (size_t bucket = 0; bucket < source->size(); bucket++) {
+			if (values[bucket] != 0) {
+				counts[bucket] += values[bucket];
+				lowest  = std::min(lowest, bucket);
+				highest = std::max(highest, bucket);
+				count += values[bucket];
+				minimum = std::min(minimum, histogram::lowest(bucket, _precision));
+				maximum = std::max(maximum, histogram::highest(bucket, _precision));
+			}
+		}
+		sum += buckets->total_time();
+	}
+
+	report&   result = _reports[index];
+	uint64_t* values = _values.data() + index * _quantiles.size();
+	result.zone      = sources.zone;
+	result.count     = count;
+	result.sum       = sum + static_cast<double>(exact);
+	result.values    = values;
+	if (count == 0) {
+		result.minimum = 0;
+		result.maximum = 0;
+		std::fill(values, values + _quantiles.size(), uint64_t(0));
+		return;
+	}
+	result.minimum = minimum;
+	result.maximum = maximum;
+
+	// Quantiles are sorted, so a single walk over the touched buckets finds all of them. Bucket bounds are clamped
+	// to the exact extremes, so a quantile never lies outside of them.
+	size_t   bucket = lowest;
+	uint64_t accum  = counts[bucket];
+	for (size_t quantile = 0; quantile < _quantiles.size(); quantile++) {
+		double   rank_exact = std::ceil(_quantiles[quantile] * static_cast<double>(count));
+		uint64_t rank       = rank_exact < 1. ? 1 : static_cast<uint64_t>(rank_exact);
+		while ((accum < rank) && (bucket < highest)) {
+			accum += counts[++bucket];
+		}
+		values[quantile] = std::max(minimum, std::min(maximum, histogram::highest(bucket, _precision)));
+	}
+
+	// Leave the scratch buckets empty for the next zone, touching only what was used.
+	std::fill(counts + lowest, counts + highest + 1, uint64_t(0));
+}
@@ -0,0 +1,291 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/resources.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include "xmr/utility/profiler/clock/hpc.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace xmr::utility::profiler;
+
+#ifdef __linux__
+/** Descriptors of the files read for every sample, opened on first use and kept for the lifetime of the process.
+ */
+struct resources_files {
+	int stat;
+	int status;
+
+	resources_files()
+		: stat(::open("/proc/self/stat", O_RDONLY | O_CLOEXEC)),
+		  status(::open("/proc/self/status", O_RDONLY | O_CLOEXEC))
+	{}
+
+	~resources_files()
+	{
+		if (stat >= 0) {
+			::close(stat);
+		}
+		if (status >= 0) {
+			::close(status);
+		}
+	}
+};
+
+static resources_files& resources_files_instance()
+{
+	static resources_files files;
+	return files;
+}
+
+/** Read a whole file from the start into a buffer, leaving room for a terminating zero.
+ */
+static size_t resources_load(int fd, char* buffer, size_t size)
+{
+	size_t length = 0;
+	while ((fd >= 0) && (length < (size - 1))) {
+		ssize_t read = ::pread(fd, buffer + length, size - 1 - length, static_cast<off_t>(length));
+		if (read < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 0;
+		}
+		if (read == 0) {
+			break;
+		}
+		length += static_cast<size_t>(read);
+	}
+	buffer[length] = '\0';
+	return length;
+}
+
+static uint64_t resources_number(const char*& cursor)
+{
+	while (*cursor == ' ') {
+		cursor++;
+	}
+	uint64_t value = 0;
+	while ((*cursor >= '0') && (*cursor <= '9')) {
+		value = value * 10 + static_cast<uint64_t>(*cursor - '0');
+		cursor++;
+	}
+	return value;
+}
+
+/** Find a "Key: value kB" line of /proc/self/status.
+ */
+static uint64_t resources_status(const char* text, const char* key, size_t key_length)
+{
+	for (const char* line = text; *line; line++) {
+		if ((std::strncmp(line, key, key_length) == 0) && (line[key_length] == ':')) {
+			const char* cursor = line + key_length + 1;
+			while (*cursor == '\t') {
+				cursor++;
+			}
+			return resources_number(cursor) * 1024;
+		}
+		line = std::strchr(line, '\n');
+		if (!line) {
+			break;
+		}
+	}
+	return 0;
+}
+
+static bool resources_read_proc(resources::sample& result)
+{
+	resources_files& files = resources_files_instance();
+	char             buffer[4096];
+	bool             found = false;
+
+	// The process name may contain spaces and parentheses, so fields are counted from the last ')'.
+	if (resources_load(files.stat, buffer, sizeof(buffer)) > 0) {
+		const char* cursor = std::strrchr(buffer, ')');
+		if (cursor) {
+			cursor += 2; // Skip ") ", leaving the state as field 3.
+			for (size_t field = 3; *cursor && (field <= 23); field++) {
+				while (*cursor == ' ') {
+					cursor++;
+				}
+				if (field == 20) {
+					result.threads = resources_number(cursor);
+				} else if (field == 23) {
+					result.virtual_size = resources_number(cursor);
+				}
+				while (*cursor && (*cursor != ' ')) {
+					cursor++;
+				}
+			}
+			found = true;
+		}
+	}
+
+	if (resources_load(files.status, buffer, sizeof(buffer)) > 0) {
+		result.resident      = resources_status(buffer, "VmRSS", 5);
+		result.resident_peak = resources_status(buffer, "VmHWM", 5);
+		result.swapped       = resources_status(buffer, "VmSwap", 6);
+		found                = true;
+	}
+	return found;
+}
+#endif
+
+bool xmr::utility::profiler::resources::read(sample& result)
+{
+	std::memset(&result, 0, sizeof(result));
+	result.time = clock::hpc::now();
+
+	bool found = false;
+#ifdef __linux__
+	found = resources_read_proc(result);
+#endif
+
+#ifndef _WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		result.user_time = static_cast<uint64_t>(usage.ru_utime.tv_sec) * 1000000000ull
+						   + static_cast<uint64_t>(usage.ru_utime.tv_usec) * 1000ull;
+		result.system_time = static_cast<uint64_t>(usage.ru_stime.tv_sec) * 1000000000ull
+							 + static_cast<uint64_t>(usage.ru_stime.tv_usec) * 1000ull;
+		result.minor_faults         = static_cast<uint64_t>(usage.ru_minflt);
+		result.major_faults         = static_cast<uint64_t>(usage.ru_majflt);
+		result.voluntary_switches   = static_cast<uint64_t>(usage.ru_nvcsw);
+		result.involuntary_switches = static_cast<uint64_t>(usage.ru_nivcsw);
+		result.block_reads          = static_cast<uint64_t>(usage.ru_inblock);
+		result.block_writes         = static_cast<uint64_t>(usage.ru_oublock);
+#ifndef __linux__
+		// Kilobytes on most systems, bytes on macOS.
+#ifdef __APPLE__
+		result.resident_peak = static_cast<uint64_t>(usage.ru_maxrss);
+#else
+		result.resident_peak = static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+		found = true;
+	}
+#endif
+	return found;
+}
+
+struct resources_state {
+	std::mutex                     control; // Serializes start() and stop().
+	std::mutex                     lock;
+	std::condition_variable        signal;
+	std::thread                    thread;
+	bool                           stop;
+	std::vector<resources::sample> ring;
+	size_t                         head; // Slot the next sample is written to.
+	size_t                         count;
+
+	resources_state() : control(), lock(), signal(), thread(), stop(false), ring(), head(0), count(0)
+	{
+#ifdef __linux__
+		// Open the files first, so they are destroyed only after the thread has been joined.
+		resources_files_instance();
+#endif
+	}
+
+	// A thread still running at exit must be joined, destroying it while joinable terminates the process.
+	~resources_state()
+	{
+		std::lock_guard<std::mutex> c(control);
+		halt();
+	}
+
+	void halt()
+	{
+		std::thread running;
+		{
+			std::lock_guard<std::mutex> l(lock);
+			stop    = true;
+			running = std::move(thread);
+		}
+		signal.notify_all();
+		if (running.joinable()) {
+			running.join();
+		}
+	}
+};
+
+static resources_state& resources_instance()
+{
+	static resources_state state;
+	return state;
+}
+
+void xmr::utility::profiler::resources::start(uint64_t interval, size_t capacity)
+{
+	resources_state&            state = resources_instance();
+	std::lock_guard<std::mutex> c(state.control);
+	state.halt();
+
+	std::lock_guard<std::mutex> l(state.lock);
+	state.ring.assign(std::max<size_t>(capacity, 1), sample());
+	state.head   = 0;
+	state.count  = 0;
+	state.stop   = false;
+	state.thread = std::thread([&state, interval]() {
+		std::unique_lock<std::mutex> ul(state.lock);
+		while (!state.stop) {
+			// Sample without the lock, reading the files may block briefly.
+			ul.unlock();
+			sample current;
+			bool   valid = read(current);
+			ul.lock();
+
+			if (valid) {
+				state.ring[state.head] = current;
+				state.head             = (state.head + 1) % state.ring.size();
+				state.count            = std::min(state.count + 1, state.ring.size());
+			}
+
+			state.signal.wait_for(ul, std::chrono::nanoseconds(interval));
+		}
+	});
+}
+
+void xmr::utility::profiler::resources::stop()
+{
+	resources_state&            state = resources_instance();
+	std::lock_guard<std::mutex> c(state.control);
+	state.halt();
+}
+
+void xmr::utility::profiler::resources::snapshot(std::vector<sample>& samples)
+{
+	resources_state&            state = resources_instance();
+	std::lock_guard<std::mutex> l(state.lock);
+	samples.resize(state.count);
+	if (state.count == 0) {
+		return;
+	}
+
+	size_t oldest = (state.head + state.ring.size() - state.count) % state.ring.size();
+	for (size_t idx = 0; idx < state.count; idx++) {
+		samples[idx] = state.ring[(oldest + idx) % state.ring.size()];
+	}
+}
@@ -0,0 +1,168 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/slo.hpp"
+
+#include <algorithm>
+#include <string>
+
+static std::mutex& slo_lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+static std::vector<xmr::utility::profiler::slo*>& slo_instances()
+{
+	static std::vector<xmr::utility::profiler::slo*> instances;
+	return instances;
+}
+
+static uint64_t slo_age(uint64_t now, uint64_t time)
+{
+	return (now > time) ? (now - time) : 0;
+}
+
+xmr::utility::profiler::slo::~slo()
+{
+	std::lock_guard<std::mutex> l(slo_lock());
+	auto&                       instances = slo_instances();
+	instances.erase(std::remove(instances.begin(), instances.end(), this), instances.end());
+}
+
+xmr::utility::profiler::slo::slo(uint32_t zone, uint64_t threshold, double objective,
+								 const std::vector<window>& windows, const callback_t& callback)
+	: _zone(zone), _threshold(threshold), _objective(objective), _lock(), _windows(windows),
+	  _burn_rates(windows.size(), 0.), _above(windows.size(), false), _counters(), _history(), _callback(callback)
+{
+	_counts[0].store(0, std::memory_order_relaxed);
+	_counts[1].store(0, std::memory_order_relaxed);
+
+	const char* name = registry::name(zone);
+	for (size_t idx = 0; idx < _windows.size(); idx++) {
+		std::string counter = std::string(name ? name : "(unknown)") + " burn rate " + std::to_string(idx);
+		_counters.emplace_back(new trace::counter(counter.c_str()));
+	}
+
+	std::lock_guard<std::mutex> l(slo_lock());
+	slo_instances().push_back(this);
+}
+
+xmr::utility::profiler::slo::slo(uint32_t zone, std::chrono::nanoseconds threshold, uint64_t frequency,
+								 double objective, const std::vector<window>& windows, const callback_t& callback)
+	: slo(zone, ticks(threshold, frequency), objective, windows, callback)
+{}
+
+uint64_t xmr::utility::profiler::slo::ticks(std::chrono::nanoseconds duration, uint64_t frequency)
+{
+	if (duration.count() <= 0) {
+		return 0;
+	}
+	// Split into whole seconds and the remainder so that neither multiplication overflows.
+	uint64_t ns      = static_cast<uint64_t>(duration.count());
+	uint64_t seconds = ns / 1000000000ull;
+	uint64_t rest    = ns % 1000000000ull;
+	return (seconds * frequency) + ((rest * frequency) / 1000000000ull);
+}
+
+void xmr::utility::profiler::slo::update(uint64_t now)
+{
+	std::vector<std::pair<size_t, double>> crossed;
+	{
+		std::lock_guard<std::mutex> l(_lock);
+
+		sample current;
+		current.time = now;
+		current.good = _counts[0].load(std::memory_order_relaxed);
+		current.bad  = _counts[1].load(std::memory_order_relaxed);
+		_history.push_back(current);
+
+		// Only keep as much history as the longest window needs, plus one sample at or before its start.
+		uint64_t longest = 0;
+		for (auto& entry : _windows) {
+			longest = std::max(longest, entry.length);
+		}
+		while ((_history.size() > 1) && (slo_age(now, _history[1].time) >= longest)) {
+			_history.pop_front();
+		}
+
+		double budget = 1. - _objective;
+		for (size_t idx = 0; idx < _windows.size(); idx++) {
+			// Find the newest sample at or before the start of the window, or the oldest one if history is shorter.
+			const sample* start = &_history.front();
+			for (auto itr = _history.rbegin(); itr != _history.rend(); itr++) {
+				if (slo_age(now, itr->time) >= _windows[idx].length) {
+					start = &(*itr);
+					break;
+				}
+			}
+
+			uint64_t good  = current.good - start->good;
+			uint64_t bad   = current.bad - start->bad;
+			double   total = static_cast<double>(good + bad);
+			double   rate  = 0.;
+			if ((total > 0.) && (budget > 0.)) {
+				rate = (static_cast<double>(bad) / total) / budget;
+			}
+			_burn_rates[idx] = rate;
+			_counters[idx]->set(static_cast<int64_t>(rate * 1000.));
+
+			if (_windows[idx].level > 0.) {
+				bool above = rate >= _windows[idx].level;
+				if (above != _above[idx]) {
+					_above[idx] = above;
+					if (_callback) {
+						crossed.emplace_back(idx, rate);
+					}
+				}
+			}
+		}
+	}
+
+	// Invoke the callback without holding the lock, so it may query the objective.
+	for (auto& entry : crossed) {
+		_callback(*this, entry.first, entry.second, entry.second >= _windows[entry.first].level);
+	}
+}
+
+double xmr::utility::profiler::slo::burn_rate(size_t window)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	if (window >= _burn_rates.size()) {
+		return 0.;
+	}
+	return _burn_rates[window];
+}
+
+void xmr::utility::profiler::slo::get(status& state)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	state.zone       = _zone;
+	state.threshold  = _threshold;
+	state.objective  = _objective;
+	state.good       = _counts[0].load(std::memory_order_relaxed);
+	state.bad        = _counts[1].load(std::memory_order_relaxed);
+	state.burn_rates = _burn_rates;
+}
+
+void xmr::utility::profiler::slo::snapshot(std::vector<status>& states)
+{
+	std::lock_guard<std::mutex> l(slo_lock());
+	auto&                       instances = slo_instances();
+	states.resize(instances.size());
+	for (size_t idx = 0; idx < instances.size(); idx++) {
+		instances[idx]->get(states[idx]);
+	}
+}
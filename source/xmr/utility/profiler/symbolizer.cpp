@@ -0,0 +1,395 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/symbolizer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#ifdef __linux__
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const unsigned char symbolizer_class = (sizeof(void*) == 8) ? ELFCLASS64 : ELFCLASS32;
+#endif
+
+/** Single ELF file mapped into the process.
+ *
+ * The file stays mapped for as long as the module exists, so symbol names point straight into its string tables.
+ */
+struct xmr::utility::profiler::symbolizer::module {
+	struct symbol {
+		uintptr_t   start;
+		uintptr_t   end;
+		const char* name;
+	};
+
+	std::string         path;
+	uintptr_t           start = 0; // Lowest mapped address.
+	uintptr_t           end   = 0; // Highest mapped address, exclusive.
+	void*               data  = nullptr;
+	size_t              size  = 0;
+	std::vector<symbol> symbols; // Sorted by start address.
+
+	~module()
+	{
+#ifdef __linux__
+		if (data) {
+			munmap(data, size);
+		}
+#endif
+	}
+
+#ifdef __linux__
+	/** Map the file and read its function symbols.
+	 *
+	 * @param bias Difference between run-time and link-time addresses.
+	 */
+	void load(uintptr_t bias)
+	{
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			return;
+		}
+		struct stat info;
+		if ((fstat(fd, &info) != 0) || (static_cast<size_t>(info.st_size) < sizeof(ElfW(Ehdr)))) {
+			close(fd);
+			return;
+		}
+		size = static_cast<size_t>(info.st_size);
+		data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED) {
+			data = nullptr;
+			return;
+		}
+
+		const uint8_t*    base   = static_cast<const uint8_t*>(data);
+		const ElfW(Ehdr)* header = reinterpret_cast<const ElfW(Ehdr)*>(base);
+		if ((std::memcmp(header->e_ident, ELFMAG, SELFMAG) != 0) || (header->e_ident[EI_CLASS] != symbolizer_class)
+			|| (header->e_shentsize != sizeof(ElfW(Shdr)))
+			|| ((header->e_shoff + header->e_shnum * sizeof(ElfW(Shdr))) > size)) {
+			return;
+		}
+
+		const ElfW(Shdr)* sections = reinterpret_cast<const ElfW(Shdr)*>(base + header->e_shoff);
+		for (size_t idx = 0; idx < header->e_shnum; idx++) {
+			const ElfW(Shdr)& section = sections[idx];
+			if (((section.sh_type != SHT_SYMTAB) && (section.sh_type != SHT_DYNSYM))
+				|| (section.sh_entsize != sizeof(ElfW(Sym))) || (section.sh_link >= header->e_shnum)
+				|| ((section.sh_offset + section.sh_size) > size)) {
+				continue;
+			}
+			const ElfW(Shdr)& strings = sections[section.sh_link];
+			if ((strings.sh_offset + strings.sh_size) > size) {
+				continue;
+			}
+
+			const ElfW(Sym)* entries = reinterpret_cast<const ElfW(Sym)*>(base + section.sh_offset);
+			const char*      names   = reinterpret_cast<const char*>(base + strings.sh_offset);
+			size_t           count   = section.sh_size / sizeof(ElfW(Sym));
+			for (size_t sym = 0; sym < count; sym++) {
+				const ElfW(Sym)& entry = entries[sym];
+				unsigned char    type  = ELF32_ST_TYPE(entry.st_info);
+				if (((type != STT_FUNC) && (type != STT_GNU_IFUNC)) || (entry.st_shndx == SHN_UNDEF)
+					|| (entry.st_value == 0) || (entry.st_name >= strings.sh_size)) {
+					continue;
+				}
+
+				symbol target;
+				target.start = static_cast<uintptr_t>(entry.st_value) + bias;
+				target.end   = target.start + static_cast<uintptr_t>(entry.st_size);
+				target.name  = names + entry.st_name;
+				symbols.push_back(target);
+			}
+		}
+
+		// .symtab and .dynsym overlap, and aliases share an address. Keep the first name for each address.
+		std::sort(symbols.begin(), symbols.end(), [](const symbol& a, const symbol& b) {
+			return (a.start < b.start) || ((a.start == b.start) && (a.end > b.end));
+		});
+		symbols.erase(std::unique(symbols.begin(), symbols.end(),
+								  [](const symbol& a, const symbol& b) { return a.start == b.start; }),
+					  symbols.end());
+
+		// Symbols without a size extend up to the next symbol.
+		for (size_t idx = 0; idx < symbols.size(); idx++) {
+			if (symbols[idx].end == symbols[idx].start) {
+				symbols[idx].end = (idx + 1 < symbols.size()) ? symbols[idx + 1].start : end;
+			}
+		}
+	}
+#endif
+
+	const symbol* find(uintptr_t address) const
+	{
+		auto itr = std::upper_bound(symbols.begin(), symbols.end(), address,
+									[](uintptr_t value, const symbol& entry) { return value < entry.start; });
+		if (itr == symbols.begin()) {
+			return nullptr;
+		}
+		--itr;
+		if (address >= itr->end) {
+			return nullptr;
+		}
+		return &(*itr);
+	}
+};
+
+xmr::utility::profiler::symbolizer::~symbolizer() {}
+
+xmr::utility::profiler::symbolizer::symbolizer() : _lock(), _modules(), _demangled()
+{
+	refresh();
+}
+
+void xmr::utility::profiler::symbolizer::refresh()
+{
+#ifdef __linux__
+	struct mapping {
+		uintptr_t   start;
+		uintptr_t   end;
+		uint64_t    offset;
+		std::string path;
+	};
+
+	std::vector<mapping> mappings;
+	{
+		std::FILE* file = std::fopen("/proc/self/maps", "r");
+		if (!file) {
+			return;
+		}
+
+		char line[4096];
+		while (std::fgets(line, sizeof(line), file)) {
+			unsigned long long start = 0, end = 0, offset = 0;
+			char               permissions[8] = {0};
+			int                consumed       = 0;
+			if (std::sscanf(line, "%llx-%llx %7s %llx %*s %*s %n", &start, &end, permissions, &offset, &consumed)
+				< 4) {
+				continue;
+			}
+
+			std::string path = line + consumed;
+			while (!path.empty() && ((path.back() == '\n') || (path.back() == ' '))) {
+				path.pop_back();
+			}
+			if (path.empty() || (path[0] != '/')) {
+				continue;
+			}
+
+			mapping entry;
+			entry.start  = static_cast<uintptr_t>(start);
+			entry.end    = static_cast<uintptr_t>(end);
+			entry.offset = offset;
+			entry.path   = path;
+			mappings.push_back(entry);
+		}
+		std::fclose(file);
+	}
+
+	// A file is usually mapped several times with different permissions, sometimes with anonymous mappings in
+	// between. Merge all of them into one address range, and remember the lowest one to compute the bias from.
+	std::map<std::string, mapping> files;
+	for (auto& entry : mappings) {
+		auto known = files.find(entry.path);
+		if (known == files.end()) {
+			files.emplace(entry.path, entry);
+		} else if (entry.start < known->second.start) {
+			uintptr_t end     = std::max(known->second.end, entry.end);
+			known->second     = entry;
+			known->second.end = end;
+		} else {
+			known->second.end = std::max(known->second.end, entry.end);
+		}
+	}
+
+	std::lock_guard<std::mutex> l(_lock);
+	for (auto& kv : files) {
+		const mapping&  first = kv.second;
+		const uintptr_t end   = first.end;
+
+		bool known = false;
+		for (auto& existing : _modules) {
+			if ((existing->start == first.start) && (existing->path == first.path)) {
+				known = true;
+				break;
+			}
+		}
+		if (known) {
+			continue;
+		}
+
+		std::unique_ptr<module> entry(new module());
+		entry->path  = first.path;
+		entry->start = first.start;
+		entry->end   = end;
+
+		// The bias follows from the first loadable segment, which the first mapping of the file belongs to.
+		uintptr_t bias = 0;
+		{
+			int fd = open(first.path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0) {
+				continue;
+			}
+			ElfW(Ehdr) header;
+			bool       valid = (pread(fd, &header, sizeof(header), 0) == sizeof(header))
+						 && (std::memcmp(header.e_ident, ELFMAG, SELFMAG) == 0);
+			if (valid && (header.e_type == ET_DYN)) {
+				for (size_t phdr = 0; phdr < header.e_phnum; phdr++) {
+					ElfW(Phdr) program;
+					off_t      where = static_cast<off_t>(header.e_phoff + phdr * sizeof(program));
+					if (pread(fd, &program, sizeof(program), where) != sizeof(program)) {
+						break;
+					}
+					if (program.p_type != PT_LOAD) {
+						continue;
+					}
+
+					// Segments are mapped from page boundaries, so align down before comparing.
+					uint64_t align  = (program.p_align > 1) ? program.p_align : 1;
+					uint64_t offset = program.p_offset & ~(align - 1);
+					uint64_t vaddr  = program.p_vaddr & ~(align - 1);
+					if ((offset <= first.offset) && (first.offset < (program.p_offset + program.p_filesz))) {
+						bias = first.start - static_cast<uintptr_t>(vaddr + (first.offset - offset));
+						break;
+					}
+				}
+			}
+			close(fd);
+			if (!valid) {
+				continue;
+			}
+		}
+
+		entry->load(bias);
+		_modules.push_back(std::move(entry));
+	}
+
+	std::sort(_modules.begin(), _modules.end(),
+			  [](const std::unique_ptr<module>& a, const std::unique_ptr<module>& b) { return a->start < b->start; });
+#endif
+}
+
+const char* xmr::utility::profiler::symbolizer::find(uintptr_t address, uint64_t* offset)
+{
+	auto itr = std::upper_bound(_modules.begin(), _modules.end(), address,
+								[](uintptr_t value, const std::unique_ptr<module>& entry) { return value < entry->start; });
+	if (itr == _modules.begin()) {
+		return nullptr;
+	}
+	--itr;
+	if (address >= (*itr)->end) {
+		return nullptr;
+	}
+
+	const module::symbol* entry = (*itr)->find(address);
+	if (!entry) {
+		return nullptr;
+	}
+	if (offset) {
+		*offset = address - entry->start;
+	}
+	return entry->name;
+}
+
+const std::string& xmr::utility::profiler::symbolizer::demangle(const char* name)
+{
+	auto cached = _demangled.find(name);
+	if (cached != _demangled.end()) {
+		return cached->second;
+	}
+
+	std::string result = name;
+#ifdef __linux__
+	int   status    = 0;
+	char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+	if ((status == 0) && demangled) {
+		result = demangled;
+	}
+	std::free(demangled);
+#endif
+	return _demangled.emplace(name, std::move(result)).first->second;
+}
+
+bool xmr::utility::profiler::symbolizer::resolve(const void* address, std::string& name, uint64_t* offset)
+{
+	std::lock_guard<std::mutex> l(_lock);
+	const char*                 symbol = find(reinterpret_cast<uintptr_t>(address), offset);
+	if (!symbol) {
+		return false;
+	}
+	name = demangle(symbol);
+	return true;
+}
+
+void xmr::utility::profiler::symbolizer::resolve(const std::vector<const void*>& addresses,
+												 std::vector<std::string>& names)
+{
+	names.assign(addresses.size(), std::string());
+
+	std::vector<size_t> order(addresses.size());
+	for (size_t idx = 0; idx < order.size(); idx++) {
+		order[idx] = idx;
+	}
+	std::sort(order.begin(), order.end(), [&addresses](size_t a, size_t b) {
+		return reinterpret_cast<uintptr_t>(addresses[a]) < reinterpret_cast<uintptr_t>(addresses[b]);
+	});
+
+	std::lock_guard<std::mutex> l(_lock);
+	const module*               current_module = nullptr;
+	const module::symbol*       current_symbol = nullptr;
+	auto                        next_module    = _modules.begin();
+	for (size_t idx : order) {
+		uintptr_t address = reinterpret_cast<uintptr_t>(addresses[idx]);
+
+		// Addresses are ascending, so the module and symbol only ever move forward.
+		if (current_symbol && (address >= current_symbol->start) && (address < current_symbol->end)) {
+			names[idx] = demangle(current_symbol->name);
+			continue;
+		}
+		if (!current_module || (address >= current_module->end)) {
+			current_module = nullptr;
+			while ((next_module != _modules.end()) && ((*next_module)->end <= address)) {
+				++next_module;
+			}
+			if ((next_module != _modules.end()) && ((*next_module)->start <= address)) {
+				current_module = next_module->get();
+			}
+		}
+		if (!current_module) {
+			continue;
+		}
+
+		current_symbol = current_module->find(address);
+		if (current_symbol) {
+			names[idx] = demangle(current_symbol->name);
+		}
+	}
+}
+
+xmr::utility::profiler::symbolizer& xmr::utility::profiler::symbolizer::instance()
+{
+	static symbolizer shared;
+	return shared;
+}
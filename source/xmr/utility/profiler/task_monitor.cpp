@@ -0,0 +1,235 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/task_monitor.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <set>
+#include "xmr/utility/profiler/registry.hpp"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+using namespace xmr::utility::profiler;
+
+/** Usage of a worker thread, on its own cache line as it is updated after every task.
+ *
+ * Allocated with the alignment of the cache line, which plain operator new does not guarantee before C++17.
+ */
+struct alignas(64) xmr::utility::profiler::task_monitor::worker {
+	std::atomic<uint64_t> busy;
+	std::atomic<uint64_t> tasks;
+	std::atomic<uint64_t> since; // Time utilization is measured from.
+	uint32_t              thread;
+
+	static void* operator new(size_t size)
+	{
+#ifdef _WIN32
+		void* memory = _aligned_malloc(size, alignof(worker));
+#else
+		void* memory = nullptr;
+		if (posix_memalign(&memory, alignof(worker), size) != 0) {
+			memory = nullptr;
+		}
+#endif
+		if (!memory) {
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+
+	static void operator delete(void* memory)
+	{
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+};
+
+/** Worker slot of the calling thread in one monitor.
+ */
+struct task_monitor_cache {
+	uint64_t serial;
+	void*    slot;
+};
+
+static std::atomic<uint64_t> task_monitor_serials(1);
+
+// The monitor the thread last ran a task for, and every monitor it has run tasks for. Serials are never reused, so
+// entries of destroyed monitors are never matched again, and are pruned whenever the thread adds an entry.
+static thread_local task_monitor_cache              task_monitor_last = {0, nullptr};
+static thread_local std::vector<task_monitor_cache> task_monitor_known;
+
+static std::mutex& task_monitor_lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+static std::set<uint64_t>& task_monitor_alive()
+{
+	static std::set<uint64_t> alive;
+	return alive;
+}
+
+xmr::utility::profiler::task_monitor::~task_monitor()
+{
+	std::lock_guard<std::mutex> l(task_monitor_lock());
+	task_monitor_alive().erase(_serial);
+}
+
+xmr::utility::profiler::task_monitor::task_monitor(uint32_t precision)
+	: _serial(task_monitor_serials.fetch_add(1, std::memory_order_relaxed)), _precision(precision),
+	  _types(new std::atomic<task_type*>[registry::capacity]), _lock(), _owned(), _workers()
+{
+	for (size_t idx = 0; idx < registry::capacity; idx++) {
+		_types[idx].store(nullptr, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> l(task_monitor_lock());
+	task_monitor_alive().insert(_serial);
+}
+
+xmr::utility::profiler::task_monitor::task_type& xmr::utility::profiler::task_monitor::get(uint32_t zone)
+{
+	if (zone >= registry::capacity) {
+		zone = registry::overflow();
+	}
+
+	task_type* type = _types[zone].load(std::memory_order_acquire);
+	if (type) {
+		return *type;
+	}
+
+	std::lock_guard<std::mutex> l(_lock);
+	type = _types[zone].load(std::memory_order_relaxed);
+	if (!type) {
+		_owned.emplace_back(new task_type(zone, _precision));
+		type = _owned.back().get();
+		_types[zone].store(type, std::memory_order_release);
+	}
+	return *type;
+}
+
+void xmr::utility::profiler::task_monitor::finish(task_type& type, uint64_t start, uint64_t end)
+{
+	uint64_t duration = end >= start ? (end - start) : 0;
+	type.run.record(duration);
+
+	// Only the owning thread adds to its slot, so the increments are uncontended. They still have to be atomic, or one
+	// could undo a concurrent clear().
+	worker& slot = local(start);
+	slot.busy.fetch_add(duration, std::memory_order_relaxed);
+	slot.tasks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void xmr::utility::profiler::task_monitor::collect(std::vector<type_report>& reports)
+{
+	std::vector<task_type*> types;
+	{
+		std::lock_guard<std::mutex> l(_lock);
+		for (auto& type : _owned) {
+			types.push_back(type.get());
+		}
+	}
+	std::sort(types.begin(), types.end(), [](task_type* a, task_type* b) { return a->zone < b->zone; });
+
+	reports.clear();
+	reports.reserve(types.size());
+	for (auto type : types) {
+		reports.push_back({type->zone, histogram(_precision), histogram(_precision)});
+		type->wait.snapshot(reports.back().wait);
+		type->run.snapshot(reports.back().run);
+	}
+}
+
+void xmr::utility::profiler::task_monitor::workers(std::vector<worker_report>& reports)
+{
+	uint64_t                    now = clock::hpc::now();
+	std::lock_guard<std::mutex> l(_lock);
+	reports.resize(_workers.size());
+	for (size_t idx = 0; idx < _workers.size(); idx++) {
+		const worker&  slot   = *_workers[idx];
+		worker_report& report = reports[idx];
+		uint64_t       since  = slot.since.load(std::memory_order_relaxed);
+		report.thread         = slot.thread;
+		report.tasks          = slot.tasks.load(std::memory_order_relaxed);
+		report.busy           = slot.busy.load(std::memory_order_relaxed);
+		report.elapsed        = now > since ? (now - since) : 0;
+		report.utilization    = report.elapsed > 0
+									? std::min(1., static_cast<double>(report.busy) / static_cast<double>(report.elapsed))
+									: 0.;
+	}
+}
+
+void xmr::utility::profiler::task_monitor::clear()
+{
+	uint64_t                    now = clock::hpc::now();
+	std::lock_guard<std::mutex> l(_lock);
+	for (auto& type : _owned) {
+		type->wait.clear();
+		type->run.clear();
+	}
+
+	// A task finishing right now is counted either before or after the reset, or split between the two.
+	for (auto& slot : _workers) {
+		slot->busy.store(0, std::memory_order_relaxed);
+		slot->tasks.store(0, std::memory_order_relaxed);
+		slot->since.store(now, std::memory_order_relaxed);
+	}
+}
+
+xmr::utility::profiler::task_monitor::worker& xmr::utility::profiler::task_monitor::local(uint64_t now)
+{
+	if (task_monitor_last.serial == _serial) {
+		return *static_cast<worker*>(task_monitor_last.slot);
+	}
+
+	// The thread switched between monitors, or runs its first task for this one.
+	for (auto& entry : task_monitor_known) {
+		if (entry.serial == _serial) {
+			task_monitor_last = entry;
+			return *static_cast<worker*>(entry.slot);
+		}
+	}
+
+	worker* slot;
+	{
+		std::lock_guard<std::mutex> l(_lock);
+		_workers.emplace_back(new worker());
+		slot = _workers.back().get();
+		slot->busy.store(0, std::memory_order_relaxed);
+		slot->tasks.store(0, std::memory_order_relaxed);
+		slot->since.store(now, std::memory_order_relaxed);
+		slot->thread = static_cast<uint32_t>(_workers.size());
+	}
+	{
+		std::lock_guard<std::mutex> l(task_monitor_lock());
+		auto&                       alive = task_monitor_alive();
+		task_monitor_known.erase(std::remove_if(task_monitor_known.begin(), task_monitor_known.end(),
+												[&alive](const task_monitor_cache& entry) {
+													return alive.find(entry.serial) == alive.end();
+												}),
+								 task_monitor_known.end());
+	}
+	task_monitor_last = {_serial, slot};
+	task_monitor_known.push_back(task_monitor_last);
+	return *slot;
+}
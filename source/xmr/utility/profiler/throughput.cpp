@@ -0,0 +1,172 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/throughput.hpp"
+#include "xmr/utility/profiler/profiler.hpp"
+
+#include <limits>
+
+using namespace xmr::utility::profiler;
+
+// Units are reduced to this many bits below their highest bit before looking up the reciprocal.
+static const uint32_t throughput_mantissa_bits = 10;
+
+// Reciprocals are 2^throughput_reciprocal_scale / mantissa, which lands them between 2^32 and 2^33.
+static const uint32_t throughput_reciprocal_scale = 43;
+
+/** Reciprocals of all mantissas from 2^throughput_mantissa_bits up to twice that, built once.
+ */
+struct throughput_table {
+	uint64_t reciprocals[size_t(1) << throughput_mantissa_bits];
+
+	throughput_table()
+	{
+		for (size_t idx = 0; idx < (size_t(1) << throughput_mantissa_bits); idx++) {
+			uint64_t mantissa = (uint64_t(1) << throughput_mantissa_bits) + idx;
+			reciprocals[idx]  = (uint64_t(1) << throughput_reciprocal_scale) / mantissa;
+		}
+	}
+};
+
+static const throughput_table& throughput_reciprocals()
+{
+	static const throughput_table table;
+	return table;
+}
+
+static uint32_t throughput_highest_bit(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#else
+	uint32_t bit = 0;
+	while (value >>= 1) {
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+/** Multiply two values and shift the 128-bit product right, saturating if the result does not fit.
+ */
+static uint64_t throughput_multiply_shift(uint64_t a, uint64_t b, uint32_t shift)
+{
+#if defined(__SIZEOF_INT128__)
+	// The typedef marks the extension, which keeps -Wpedantic quiet.
+	__extension__ typedef unsigned __int128 uint128_t;
+
+	uint128_t product = static_cast<uint128_t>(a) * b;
+	product >>= shift;
+	return (product >> 64) ? std::numeric_limits<uint64_t>::max() : static_cast<uint64_t>(product);
+#else
+	uint64_t lo_lo  = (a & 0xFFFFFFFFull) * (b & 0xFFFFFFFFull);
+	uint64_t lo_hi  = (a & 0xFFFFFFFFull) * (b >> 32);
+	uint64_t hi_lo  = (a >> 32) * (b & 0xFFFFFFFFull);
+	uint64_t hi_hi  = (a >> 32) * (b >> 32);
+	uint64_t middle = (lo_lo >> 32) + (lo_hi & 0xFFFFFFFFull) + (hi_lo & 0xFFFFFFFFull);
+	uint64_t low    = (middle << 32) | (lo_lo & 0xFFFFFFFFull);
+	uint64_t high   = hi_hi + (lo_hi >> 32) + (hi_lo >> 32) + (middle >> 32);
+	if (shift >= 64) {
+		return high >> (shift - 64);
+	}
+	if ((shift == 0) || ((high >> shift) != 0)) {
+		return high ? std::numeric_limits<uint64_t>::max() : low;
+	}
+	return (high << (64 - shift)) | (low >> shift);
+#endif
+}
+
+xmr::utility::profiler::throughput::~throughput() {}
+
+xmr::utility::profiler::throughput::throughput(uint32_t precision)
+	: _cost(precision), _events(0), _time(0), _units(0)
+{
+	throughput_reciprocals();
+}
+
+uint64_t xmr::utility::profiler::throughput::track(uint64_t time_end, uint64_t time_start, uint64_t units)
+{
+	uint64_t difference = elapsed(time_end, time_start);
+
+	record(difference, units);
+	return difference;
+}
+
+void xmr::utility::profiler::throughput::record(uint64_t time, uint64_t units)
+{
+	_events.fetch_add(1, std::memory_order_relaxed);
+	_time.fetch_add(time, std::memory_order_relaxed);
+	if (units == 0) {
+		return;
+	}
+	_units.fetch_add(units, std::memory_order_relaxed);
+
+	// units ~ mantissa * 2^(exponent - mantissa_bits), so time * 2^fraction_bits / units is time times the
+	// reciprocal of the mantissa, shifted into place. Dropping the low bits of large units is the only error.
+	uint32_t exponent = throughput_highest_bit(units);
+	uint64_t mantissa = exponent >= throughput_mantissa_bits ? (units >> (exponent - throughput_mantissa_bits))
+															 : (units << (throughput_mantissa_bits - exponent));
+	uint64_t reciprocal = throughput_reciprocals().reciprocals[mantissa - (uint64_t(1) << throughput_mantissa_bits)];
+	uint32_t shift      = throughput_reciprocal_scale - throughput_mantissa_bits - fraction_bits + exponent;
+	_cost.record(throughput_multiply_shift(time, reciprocal, shift));
+}
+
+void xmr::utility::profiler::throughput::clear()
+{
+	_cost.clear();
+	_events.store(0, std::memory_order_relaxed);
+	_time.store(0, std::memory_order_relaxed);
+	_units.store(0, std::memory_order_relaxed);
+}
+
+void xmr::utility::profiler::throughput::snapshot(histogram& target)
+{
+	_cost.snapshot(target);
+}
+
+double xmr::utility::profiler::throughput::average_throughput() const
+{
+	uint64_t time = total_time();
+	if (time == 0) {
+		return 0.;
+	}
+	return static_cast<double>(total_units()) * 1e9 / static_cast<double>(time);
+}
+
+double xmr::utility::profiler::throughput::percentile_cost(double percentile)
+{
+	histogram costs(_cost.precision());
+	_cost.snapshot(costs);
+	return percentile_cost(costs, percentile);
+}
+
+double xmr::utility::profiler::throughput::percentile_throughput(double percentile)
+{
+	histogram costs(_cost.precision());
+	_cost.snapshot(costs);
+	return percentile_throughput(costs, percentile);
+}
+
+double xmr::utility::profiler::throughput::percentile_cost(const histogram& costs, double percentile)
+{
+	return static_cast<double>(costs.percentile_events(percentile)) / static_cast<double>(uint64_t(1) << fraction_bits);
+}
+
+double xmr::utility::profiler::throughput::percentile_throughput(const histogram& costs, double percentile)
+{
+	// The throughput reached by a share of events is the inverse of the time per unit that share took at most.
+	double cost = percentile_cost(costs, percentile);
+	return cost > 0. ? (1e9 / cost) : 0.;
+}
@@ -0,0 +1,227 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/trace.hpp"
+#include "xmr/utility/profiler/clock/hpc.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace xmr::utility::profiler;
+
+/** Buffer of a single thread.
+ *
+ * Only the owning thread writes records, and publishes them by storing the new size with release semantics. Readers
+ * load the size with acquire semantics and may then read all records below it without further synchronization.
+ */
+struct trace_buffer {
+	std::unique_ptr<trace::record[]> records;
+	size_t                           capacity;
+	std::atomic<size_t>              size;
+	std::atomic<uint64_t>            dropped;
+	uint32_t                         thread;
+};
+
+static std::atomic<bool>   trace_enabled(false);
+static std::atomic<size_t> trace_capacity(0);
+static uint64_t            trace_epoch = 0;
+
+// Buffers are never freed, so records of threads that have exited can still be written.
+static std::mutex& trace_lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+static std::vector<std::unique_ptr<trace_buffer>>& trace_buffers()
+{
+	static std::vector<std::unique_ptr<trace_buffer>> buffers;
+	return buffers;
+}
+
+static thread_local trace_buffer* trace_local = nullptr;
+
+static trace_buffer* trace_acquire()
+{
+	if (trace_local) {
+		return trace_local;
+	}
+
+	std::unique_ptr<trace_buffer> buffer(new trace_buffer());
+	buffer->capacity = trace_capacity.load(std::memory_order_relaxed);
+	buffer->records.reset(new trace::record[buffer->capacity]);
+	buffer->size.store(0, std::memory_order_relaxed);
+	buffer->dropped.store(0, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> l(trace_lock());
+	auto&                       buffers = trace_buffers();
+	buffer->thread                      = static_cast<uint32_t>(buffers.size() + 1);
+	trace_local                         = buffer.get();
+	buffers.push_back(std::move(buffer));
+	return trace_local;
+}
+
+static void trace_write_escaped(std::FILE* file, const char* text)
+{
+	for (; *text != '\0'; text++) {
+		char c = *text;
+		if ((c == '"') || (c == '\\')) {
+			std::fputc('\\', file);
+			std::fputc(c, file);
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			std::fprintf(file, "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+		} else {
+			std::fputc(c, file);
+		}
+	}
+}
+
+void xmr::utility::profiler::trace::enable(size_t capacity)
+{
+	std::lock_guard<std::mutex> l(trace_lock());
+	if (trace_epoch == 0) {
+		trace_epoch = clock::hpc::now();
+	}
+	trace_capacity.store(capacity, std::memory_order_relaxed);
+	trace_enabled.store(true, std::memory_order_release);
+}
+
+void xmr::utility::profiler::trace::disable()
+{
+	trace_enabled.store(false, std::memory_order_release);
+}
+
+bool xmr::utility::profiler::trace::is_enabled()
+{
+	return trace_enabled.load(std::memory_order_relaxed);
+}
+
+void xmr::utility::profiler::trace::clear()
+{
+	std::lock_guard<std::mutex> l(trace_lock());
+	for (auto& buffer : trace_buffers()) {
+		buffer->size.store(0, std::memory_order_relaxed);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+	}
+}
+
+uint64_t xmr::utility::profiler::trace::dropped()
+{
+	uint64_t                    total = 0;
+	std::lock_guard<std::mutex> l(trace_lock());
+	for (auto& buffer : trace_buffers()) {
+		total += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+void xmr::utility::profiler::trace::emit(type kind, uint32_t zone, uint64_t payload)
+{
+	if (!trace_enabled.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	trace_buffer* buffer = trace_acquire();
+	size_t        size   = buffer->size.load(std::memory_order_relaxed);
+	if (size >= buffer->capacity) {
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	record& entry   = buffer->records[size];
+	entry.timestamp = clock::hpc::now();
+	entry.payload   = payload;
+	entry.zone      = zone;
+	entry.kind      = kind;
+	buffer->size.store(size + 1, std::memory_order_release);
+}
+
+bool xmr::utility::profiler::trace::write_chrome(std::FILE* file)
+{
+#ifdef _WIN32
+	unsigned long pid = GetCurrentProcessId();
+#else
+	unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+
+	std::lock_guard<std::mutex> l(trace_lock());
+	bool                        first = true;
+
+	std::fputs("{\"traceEvents\":[", file);
+	for (auto& buffer : trace_buffers()) {
+		size_t size = buffer->size.load(std::memory_order_acquire);
+		for (size_t idx = 0; idx < size; idx++) {
+			const record& entry = buffer->records[idx];
+
+			const char* phase;
+			switch (entry.kind) {
+			case type::begin:
+				phase = "B";
+				break;
+			case type::end:
+				phase = "E";
+				break;
+			case type::flow_begin:
+				phase = "s";
+				break;
+			case type::flow_step:
+				phase = "t";
+				break;
+			case type::flow_end:
+				phase = "f";
+				break;
+			case type::counter:
+				phase = "C";
+				break;
+			default:
+				continue;
+			}
+
+			const char* name = registry::name(entry.zone);
+			double      ts   = static_cast<double>(entry.timestamp - trace_epoch) / 1000.0;
+
+			std::fputs(first ? "\n" : ",\n", file);
+			first = false;
+			std::fputs("{\"name\":\"", file);
+			trace_write_escaped(file, name ? name : "(unknown)");
+			std::fprintf(file, "\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu", phase, ts, pid,
+						 static_cast<unsigned long>(buffer->thread));
+			if ((entry.kind == type::flow_begin) || (entry.kind == type::flow_step)
+				|| (entry.kind == type::flow_end)) {
+				// Flow events are matched by category, name and id. Binding to the enclosing slice makes the arrow
+				// end at the slice the consumer is currently in, instead of the next slice that begins.
+				std::fprintf(file, ",\"cat\":\"flow\",\"id\":\"0x%llx\"", static_cast<unsigned long long>(entry.payload));
+				if (entry.kind == type::flow_end) {
+					std::fputs(",\"bp\":\"e\"", file);
+				}
+			} else if (entry.kind == type::counter) {
+				std::fprintf(file, ",\"args\":{\"value\":%lld}",
+							 static_cast<long long>(static_cast<int64_t>(entry.payload)));
+			}
+			std::fputc('}', file);
+		}
+	}
+	std::fputs("\n],\"displayTimeUnit\":\"ns\"}\n", file);
+
+	return std::ferror(file) == 0;
+}
@@ -0,0 +1,212 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/utilization.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "xmr/utility/profiler/active.hpp"
+#include "xmr/utility/profiler/registry.hpp"
+#include "xmr/utility/profiler/trace.hpp"
+
+using namespace xmr::utility::profiler;
+
+/** Sampling state and ring of a single thread.
+ */
+struct utilization_thread {
+	std::vector<uint8_t> ring;
+	size_t               head;  // Slot the next sample is written to.
+	size_t               count; // Number of valid samples.
+	uint64_t             last;  // Busy time at the previous sample.
+	uint64_t             busy;
+	uint64_t             elapsed;
+	uint64_t             time;
+	uint32_t             zone; // Counter track, registered on the first sample taken while tracing.
+};
+
+struct utilization_state {
+	std::mutex                             control; // Serializes start() and stop().
+	std::mutex                             lock;
+	std::condition_variable                signal;
+	std::thread                            thread;
+	bool                                   stop;
+	size_t                                 capacity;
+	uint64_t                               previous; // Time of the previous sample.
+	std::map<uint32_t, utilization_thread> threads;
+
+	utilization_state() : control(), lock(), signal(), thread(), stop(false), capacity(0), previous(0), threads()
+	{
+		// Set up what the thread reads first, so it is destroyed only after the thread has been joined.
+		std::vector<active::thread_usage> usage;
+		active::usage(usage, 0);
+		trace::dropped();
+	}
+
+	// A thread still running at exit must be joined, destroying it while joinable terminates the process.
+	~utilization_state()
+	{
+		std::lock_guard<std::mutex> c(control);
+		halt();
+	}
+
+	void halt()
+	{
+		std::thread running;
+		{
+			std::lock_guard<std::mutex> l(lock);
+			stop    = true;
+			running = std::move(thread);
+		}
+		signal.notify_all();
+		if (running.joinable()) {
+			running.join();
+			active::account(false);
+		}
+	}
+};
+
+static utilization_state& utilization_instance()
+{
+	static utilization_state state;
+	return state;
+}
+
+static void utilization_sample(utilization_state& sampler, std::vector<active::thread_usage>& usage)
+{
+	uint64_t now = clock::hpc::now();
+	active::usage(usage, now);
+
+	std::lock_guard<std::mutex> l(sampler.lock);
+	uint64_t                    interval = now > sampler.previous ? (now - sampler.previous) : 0;
+	sampler.previous                     = now;
+	for (auto& entry : usage) {
+		auto known = sampler.threads.find(entry.thread);
+		if (known == sampler.threads.end()) {
+			// Nothing to compare against yet, the first interval starts now.
+			utilization_thread state = {std::vector<uint8_t>(sampler.capacity), 0, 0, entry.busy, 0, 0, now,
+										 registry::invalid_zone};
+			sampler.threads.emplace(entry.thread, std::move(state));
+			continue;
+		}
+
+		utilization_thread& state = known->second;
+		uint64_t            busy  = entry.busy > state.last ? (entry.busy - state.last) : 0;
+		busy                      = std::min(busy, interval);
+		state.last                = entry.busy;
+		state.busy += busy;
+		state.elapsed += interval;
+		state.time = now;
+
+		uint8_t percent = interval > 0 ? static_cast<uint8_t>((busy * 100 + interval / 2) / interval) : 0;
+		state.ring[state.head] = percent;
+		state.head             = (state.head + 1) % state.ring.size();
+		state.count            = std::min(state.count + 1, state.ring.size());
+
+		if (trace::is_enabled()) {
+			if (state.zone == registry::invalid_zone) {
+				char name[48];
+				std::snprintf(name, sizeof(name), "utilization thread %" PRIu32, entry.thread);
+				state.zone = registry::zone(name);
+			}
+			trace::emit(trace::type::counter, state.zone, percent);
+		}
+	}
+}
+
+void xmr::utility::profiler::utilization::start(uint64_t interval, size_t capacity)
+{
+	utilization_state&          sampler = utilization_instance();
+	std::lock_guard<std::mutex> c(sampler.control);
+	sampler.halt();
+
+	std::lock_guard<std::mutex> l(sampler.lock);
+	sampler.threads.clear();
+	sampler.capacity = std::max<size_t>(capacity, 1);
+	sampler.previous = clock::hpc::now();
+	sampler.stop     = false;
+	active::account(true);
+	sampler.thread = std::thread([&sampler, interval]() {
+		std::vector<active::thread_usage> usage;
+		std::unique_lock<std::mutex>      ul(sampler.lock);
+		while (!sampler.stop) {
+			sampler.signal.wait_for(ul, std::chrono::nanoseconds(interval));
+			if (sampler.stop) {
+				break;
+			}
+
+			ul.unlock();
+			utilization_sample(sampler, usage);
+			ul.lock();
+		}
+	});
+}
+
+void xmr::utility::profiler::utilization::stop()
+{
+	utilization_state&          sampler = utilization_instance();
+	std::lock_guard<std::mutex> c(sampler.control);
+	sampler.halt();
+}
+
+void xmr::utility::profiler::utilization::snapshot(std::vector<series>& history)
+{
+	utilization_state&          sampler = utilization_instance();
+	std::lock_guard<std::mutex> l(sampler.lock);
+	history.resize(sampler.threads.size());
+	size_t idx = 0;
+	for (auto& kv : sampler.threads) {
+		const utilization_thread& state = kv.second;
+		series&                   entry = history[idx++];
+		entry.thread                    = kv.first;
+		entry.busy                      = state.busy;
+		entry.elapsed                   = state.elapsed;
+		entry.time                      = state.time;
+		entry.samples.resize(state.count);
+		size_t oldest = (state.head + state.ring.size() - state.count) % state.ring.size();
+		for (size_t sample = 0; sample < state.count; sample++) {
+			entry.samples[sample] = state.ring[(oldest + sample) % state.ring.size()];
+		}
+	}
+}
+
+bool xmr::utility::profiler::utilization::write_report(std::FILE* file)
+{
+	std::vector<series> history;
+	snapshot(history);
+
+	std::fprintf(file, "%8s %8s %9s %9s %9s %9s %14s\n", "Thread", "Samples", "Average%", "Minimum%", "Maximum%",
+				 "Last%", "Busy(ns)");
+	for (auto& entry : history) {
+		double average = 0.;
+		if (entry.elapsed > 0) {
+			average = 100. * static_cast<double>(entry.busy) / static_cast<double>(entry.elapsed);
+		}
+		std::fprintf(file, "%8" PRIu32 " %8zu %9.1f ", entry.thread, entry.samples.size(), average);
+		if (entry.samples.empty()) {
+			std::fprintf(file, "%9s %9s %9s ", "-", "-", "-");
+		} else {
+			auto range = std::minmax_element(entry.samples.begin(), entry.samples.end());
+			std::fprintf(file, "%9u %9u %9u ", static_cast<unsigned>(*range.first),
+						 static_cast<unsigned>(*range.second), static_cast<unsigned>(entry.samples.back()));
+		}
+		std::fprintf(file, "%14" PRIu64 "\n", entry.busy);
+	}
+	return std::ferror(file) == 0;
+}
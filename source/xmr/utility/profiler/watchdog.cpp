@@ -0,0 +1,155 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include "xmr/utility/profiler/watchdog.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace xmr::utility::profiler;
+
+struct watchdog_state {
+	std::mutex              control; // Serializes start() and stop().
+	std::mutex              lock;
+	std::condition_variable signal;
+	std::thread             thread;
+	bool                    stop;
+
+	watchdog_state() : control(), lock(), signal(), thread(), stop(false)
+	{
+		// Set up the stacks the thread reads first, so they are destroyed only after the thread has been joined.
+		std::vector<active::stack> stacks;
+		active::snapshot(stacks);
+	}
+
+	// A thread still running at exit must be joined, destroying it while joinable terminates the process.
+	~watchdog_state()
+	{
+		std::lock_guard<std::mutex> c(control);
+		halt();
+	}
+
+	void halt()
+	{
+		std::thread running;
+		{
+			std::lock_guard<std::mutex> l(lock);
+			stop    = true;
+			running = std::move(thread);
+		}
+		signal.notify_all();
+		if (running.joinable()) {
+			running.join();
+		}
+	}
+};
+
+static watchdog_state& watchdog_instance()
+{
+	static watchdog_state state;
+	return state;
+}
+
+static size_t watchdog_scan(uint64_t threshold, const watchdog::callback_t& callback,
+							std::map<uint32_t, uint64_t>* reported)
+{
+	std::vector<active::stack> stacks;
+	active::snapshot(stacks);
+
+	uint64_t now   = clock::hpc::now();
+	size_t   found = 0;
+	for (auto& stack : stacks) {
+		// The outermost zone over the threshold is the one that is stuck, everything below it is only as old.
+		for (size_t idx = 0; idx < stack.entries.size(); idx++) {
+			const active::entry& entry = stack.entries[idx];
+			if ((now < entry.start) || ((now - entry.start) < threshold)) {
+				continue;
+			}
+
+			found++;
+			if (reported) {
+				auto known = reported->find(stack.thread);
+				if ((known != reported->end()) && (known->second == entry.start)) {
+					break;
+				}
+				(*reported)[stack.thread] = entry.start;
+			}
+
+			watchdog::report stuck;
+			stuck.stack    = &stack;
+			stuck.index    = idx;
+			stuck.duration = now - entry.start;
+			callback(stuck);
+			break;
+		}
+	}
+	return found;
+}
+
+void xmr::utility::profiler::watchdog::print(const report& stuck)
+{
+	const active::entry& entry = stuck.stack->entries[stuck.index];
+	const char*          name  = registry::name(entry.zone);
+	std::fprintf(stderr, "Zone '%s' on thread %" PRIu32 " has been open for %.3fms:\n", name ? name : "(unknown)",
+				 stuck.stack->thread, static_cast<double>(stuck.duration) / 1000000.0);
+	for (size_t idx = 0; idx < stuck.stack->entries.size(); idx++) {
+		const char* frame = registry::name(stuck.stack->entries[idx].zone);
+		std::fprintf(stderr, "  #%zu %s\n", idx, frame ? frame : "(unknown)");
+	}
+	if (stuck.stack->depth > stuck.stack->entries.size()) {
+		std::fprintf(stderr, "  ... %zu more\n", stuck.stack->depth - stuck.stack->entries.size());
+	}
+}
+
+size_t xmr::utility::profiler::watchdog::scan(uint64_t threshold, const callback_t& callback)
+{
+	return watchdog_scan(threshold, callback, nullptr);
+}
+
+void xmr::utility::profiler::watchdog::start(uint64_t threshold, uint64_t interval, const callback_t& callback)
+{
+	watchdog_state&             state = watchdog_instance();
+	std::lock_guard<std::mutex> c(state.control);
+	state.halt();
+
+	std::lock_guard<std::mutex> l(state.lock);
+	state.stop   = false;
+	state.thread = std::thread([&state, threshold, interval, callback]() {
+		std::map<uint32_t, uint64_t> reported;
+		std::unique_lock<std::mutex> ul(state.lock);
+		while (!state.stop) {
+			state.signal.wait_for(ul, std::chrono::nanoseconds(interval));
+			if (state.stop) {
+				break;
+			}
+
+			// Scan without the lock, so a slow callback does not delay stop() from signalling.
+			ul.unlock();
+			watchdog_scan(threshold, callback, &reported);
+			ul.lock();
+		}
+	});
+}
+
+void xmr::utility::profiler::watchdog::stop()
+{
+	watchdog_state&             state = watchdog_instance();
+	std::lock_guard<std::mutex> c(state.control);
+	state.halt();
+}
@@ -0,0 +1,84 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <xmr/utility/profiler/hdr.hpp>
+#include <xmr/utility/profiler/histogram.hpp>
+
+// Decodes payloads in the layout of HdrHistogram's encodeIntoCompressedByteBuffer, compressed with zlib at the default
+// level like java.util.zip.Deflater does, so the deflate streams are not the ones our own encoder writes.
+
+struct expectation {
+	uint64_t value;
+	uint64_t count;
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+	if (!condition) {
+		printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+static void decode(const char* name, const char* text, uint32_t precision, const expectation* expected, size_t size)
+{
+	xmr::utility::profiler::histogram target(precision);
+	if (!xmr::utility::profiler::hdr::decode_base64(text, std::strlen(text), target)) {
+		printf("FAILED: %s could not be decoded\n", name);
+		failures++;
+		return;
+	}
+
+	uint64_t total = 0;
+	for (size_t idx = 0; idx < size; idx++) {
+		uint64_t count = target.counts()[target.index(expected[idx].value)];
+		if (count != expected[idx].count) {
+			printf("FAILED: %s has %" PRIu64 " counts at %" PRIu64 ", expected %" PRIu64 "\n", name, count,
+				   expected[idx].value, expected[idx].count);
+			failures++;
+		}
+		total += expected[idx].count;
+	}
+	check(target.total_events() == total, name);
+}
+
+int main(int argc, const char** argv)
+{
+	// 3 significant digits, highest trackable value 3600000000, cookies with the V2 word size nibble.
+	static const expectation three_digits[] = {{1, 1}, {1000, 3}, {1000000, 1}, {12345678, 2}};
+	decode("3 digits", "HISTFAAAACt4nJNpmSzMwMDAwwABzFCaEURcm7yEwf4DVITpND/b+3mMTI2WLACeSAfD", 11, three_digits, 4);
+
+	// 2 significant digits, with the word size nibble of the cookies cleared.
+	static const expectation two_digits[] = {{5, 1}, {70, 2}};
+	decode("2 digits", "HISTBAAAACR4nJNpmczMwMDAwgABTFCaEURcm7yEwf4DRICTqZ4FAGIJBQg=", 8, two_digits, 2);
+
+	// A header that declares 4 bytes of counts, followed by 64KiB of zeros that must not be inflated.
+	static const char bomb[] =
+		"HISTFAAAAHJ42u3FQRGAIABFwe9oA652sRwNqGAmchjBYWBIsXt4766tJLkynevHSG9vni8AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+		"AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAACw/ZWDBIs=";
+	xmr::utility::profiler::histogram target(11);
+	check(!xmr::utility::profiler::hdr::decode_base64(bomb, std::strlen(bomb), target), "oversized payload");
+	check(target.total_events() == 0, "oversized payload left the histogram unchanged");
+
+	if (failures == 0) {
+		printf("All checks passed.\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// Copyright(C) 2021 Michael Fabian Dirks
+//
+// This program is free software : you can redistribute it and /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstdio>
+#include <xmr/utility/profiler/profiler.hpp>
+#include <xmr/utility/profiler/quantile.hpp>
+
+// Checks every quantile definition against the formulas of Hyndman and Fan, evaluated in exact rational arithmetic.
+// This pins down the offsets each definition uses, including the exact ranks that decide the discontinuous ones.
+
+using xmr::utility::profiler::quantile_definition;
+
+struct row {
+	double p;
+	double expected[9]; // One per definition, in order of quantile_definition.
+};
+
+static int failures = 0;
+
+static void check(const char* name, xmr::utility::profiler::profiler& source, const row* rows, size_t size)
+{
+	for (size_t idx = 0; idx < size; idx++) {
+		for (uint32_t definition = 1; definition <= 9; definition++) {
+			double expected = rows[idx].expected[definition - 1];
+			double value    = xmr::utility::profiler::quantile(source, rows[idx].p, quantile_definition(definition));
+			if (std::fabs(value - expected) > (1e-9 * std::fabs(expected))) {
+				printf("FAILED: %s, p %g, type %u is %.12g, expected %.12g\n", name, rows[idx].p, definition, value,
+					   expected);
+				failures++;
+			}
+		}
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	// Uneven gaps, so every definition lands on a different value.
+	{
+		static const uint64_t values[] = {3, 7, 8, 15, 21, 40, 41, 47, 62, 100};
+		static const row      rows[]   = {
+			{0.0, {3., 3., 3., 3., 3., 3., 3., 3., 3.}},
+			{0.1, {3., 5., 3., 3., 5., 3.4, 6.6, 4.466666666666667, 4.6}},
+			{0.25, {8., 8., 7., 7.5, 8., 7.75, 9.75, 7.916666666666667, 7.9375}},
+			{0.5, {21., 30.5, 21., 21., 30.5, 30.5, 30.5, 30.5, 30.5}},
+			{0.9, {62., 81., 62., 62., 81., 96.2, 65.8, 86.06666666666666, 84.8}},
+			{1.0, {100., 100., 100., 100., 100., 100., 100., 100., 100.}},
+		};
+
+		xmr::utility::profiler::profiler source;
+		for (uint64_t value : values) {
+			source.track(value, 0);
+		}
+		check("10 values", source, rows, sizeof(rows) / sizeof(rows[0]));
+	}
+
+	// p99 of 100 values is exactly the 99th value, which 0.99 * 100 in floating point misses.
+	{
+		static const row rows[] = {
+			{0.99, {99., 99.5, 99., 99., 99.5, 99.99, 99.01, 99.66333333333333, 99.6225}},
+		};
+
+		xmr::utility::profiler::profiler source;
+		for (uint64_t value = 1; value <= 100; value++) {
+			source.track(value, 0);
+		}
+		check("100 values", source, rows, sizeof(rows) / sizeof(rows[0]));
+	}
+
+	if (failures == 0) {
+		printf("All checks passed.\n");
+	}
+	return failures == 0 ? 0 : 1;
+}